@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "bandit.hh"
+
+using namespace std;
+
+UcbBandit::UcbBandit( const size_t arms, const double exploration )
+  : exploration_( exploration ),
+    sums_( arms, 0 ),
+    pulls_( arms, 0 ),
+    total_pulls_( 0 ),
+    best_score_( 0 )
+{
+  if ( arms == 0 ) {
+    throw runtime_error( "bandit: no arms" );
+  }
+}
+
+size_t UcbBandit::choose( void ) const
+{
+  size_t choice = 0;
+  double best_index = -1;
+
+  for ( size_t arm = 0; arm < sums_.size(); arm++ ) {
+    if ( pulls_[ arm ] == 0 ) {
+      return arm;
+    }
+
+    const double scaled_mean = best_score_ > 0 ? mean( arm ) / best_score_ : 0;
+    const double index = scaled_mean
+      + exploration_ * sqrt( 2 * log( double( total_pulls_ ) ) / pulls_[ arm ] );
+    if ( index > best_index ) {
+      choice = arm;
+      best_index = index;
+    }
+  }
+
+  return choice;
+}
+
+void UcbBandit::reward( const size_t arm, const double score )
+{
+  sums_.at( arm ) += max( 0.0, score );
+  pulls_.at( arm )++;
+  total_pulls_++;
+  best_score_ = max( best_score_, score );
+}
+
+size_t UcbBandit::best( void ) const
+{
+  size_t best_arm = 0;
+  for ( size_t arm = 1; arm < sums_.size(); arm++ ) {
+    if ( mean( arm ) > mean( best_arm ) ) {
+      best_arm = arm;
+    }
+  }
+  return best_arm;
+}
+
+double UcbBandit::mean( const size_t arm ) const
+{
+  return pulls_.at( arm ) ? sums_.at( arm ) / pulls_.at( arm ) : 0;
+}
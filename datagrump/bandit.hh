@@ -0,0 +1,40 @@
+#ifndef BANDIT_HH
+#define BANDIT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* UCB1 over a fixed set of arms, for tuning a controller online: play
+   an arm for a trial, report the trial's score, ask for the next arm.
+   Each arm is tried once in order, then the arm with the best mean
+   plus exploration bonus is played. Scores may be any non-negative
+   number; the means are scaled by the largest score seen so far,
+   which keeps the bonus in proportion whatever the units. */
+class UcbBandit
+{
+private:
+  double exploration_; /* weight of the bonus (1 for plain UCB1) */
+  std::vector<double> sums_;
+  std::vector<uint64_t> pulls_;
+  uint64_t total_pulls_;
+  double best_score_;
+
+public:
+  UcbBandit( const size_t arms, const double exploration );
+
+  /* The arm to play next */
+  size_t choose( void ) const;
+
+  /* A trial of the arm scored this much */
+  void reward( const size_t arm, const double score );
+
+  /* The arm with the best mean score so far */
+  size_t best( void ) const;
+
+  double mean( const size_t arm ) const;
+  uint64_t pulls( const size_t arm ) const { return pulls_.at( arm ); }
+  size_t arms( void ) const { return sums_.size(); }
+};
+
+#endif
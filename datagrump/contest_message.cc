@@ -1,3 +1,4 @@
+#include <cstring>
 #include <stdexcept>
 
 #include "contest_message.hh"
@@ -18,20 +19,94 @@ uint64_t get_header_field( const size_t n, const string & str )
   return be64toh( *data_ptr );
 }
 
+/* The first byte of a compact header holds the format version in
+   its high nibble and flags in its low nibble. A legacy header starts
+   with the high byte of a big-endian sequence number, which is zero
+   for any sequence number below 2^56, so it reads as version 0. */
+static const uint8_t COMPACT_VERSION = 1;
+static const uint8_t FLAG_HAS_ACK = 0x01;
+static const unsigned int ACK_ECN_SHIFT = 1; /* two bits above FLAG_HAS_ACK */
+
+/* payload of a legacy ack from a receiver that understands compact headers */
+static const string COMPACT_OFFER = "compact/1";
+
+/* helper to get a variable-length (base-128) field */
+uint64_t get_varint_field( size_t & offset, const string & str )
+{
+  uint64_t value = 0;
+  for ( unsigned int shift = 0; shift < 64; shift += 7 ) {
+    if ( offset >= str.size() ) {
+      throw runtime_error( "contest message too small to contain header" );
+    }
+
+    const uint8_t byte = str[ offset++ ];
+    value |= uint64_t( byte & 0x7f ) << shift;
+    if ( not (byte & 0x80) ) {
+      return value;
+    }
+  }
+
+  throw runtime_error( "contest message has malformed varint field" );
+}
+
+/* helper to get a 32-bit timestamp field (in network byte order) */
+uint64_t get_timestamp_field( size_t & offset, const string & str )
+{
+  if ( str.size() < offset + sizeof( uint32_t ) ) {
+    throw runtime_error( "contest message too small to contain header" );
+  }
+
+  /* copied out: a varint offset need not be aligned for a uint32_t */
+  uint32_t value;
+  memcpy( &value, str.data() + offset, sizeof( value ) );
+  value = be32toh( value );
+  offset += sizeof( uint32_t );
+
+  /* an unset timestamp is all ones in either width */
+  return value == uint32_t( -1 ) ? uint64_t( -1 ) : value;
+}
+
 /* Parse header from wire */
 ContestMessage::Header::Header( const string & str )
-  : sequence_number( get_header_field( 0, str ) ),
-    send_timestamp( get_header_field( 1, str ) ),
-    ack_sequence_number( get_header_field( 2, str ) ),
-    ack_send_timestamp( get_header_field( 3, str ) ),
-    ack_recv_timestamp( get_header_field( 4, str ) ),
-    ack_payload_length( get_header_field( 5, str ) )
-{}
+  : Header( uint64_t( -1 ) )
+{
+  if ( str.empty() ) {
+    throw runtime_error( "contest message too small to contain header" );
+  }
+
+  const uint8_t version = uint8_t( str[ 0 ] ) >> 4;
+
+  if ( version == 0 ) {
+    sequence_number = get_header_field( 0, str );
+    send_timestamp = get_header_field( 1, str );
+    ack_sequence_number = get_header_field( 2, str );
+    ack_send_timestamp = get_header_field( 3, str );
+    ack_recv_timestamp = get_header_field( 4, str );
+    ack_payload_length = get_header_field( 5, str );
+    return;
+  } else if ( version != COMPACT_VERSION ) {
+    throw runtime_error( "contest message has unknown header version" );
+  }
+
+  format = Format::Compact;
+
+  size_t offset = 1;
+  sequence_number = get_varint_field( offset, str );
+  send_timestamp = get_timestamp_field( offset, str );
+
+  if ( str[ 0 ] & FLAG_HAS_ACK ) {
+    ack_sequence_number = get_varint_field( offset, str );
+    ack_send_timestamp = get_timestamp_field( offset, str );
+    ack_recv_timestamp = get_timestamp_field( offset, str );
+    ack_payload_length = get_varint_field( offset, str );
+    ack_ecn = (str[ 0 ] >> ACK_ECN_SHIFT) & 0x03;
+  }
+}
 
 /* Parse incoming message from wire */
 ContestMessage::ContestMessage( const string & str )
   : header( str ),
-    payload( str.begin() + sizeof( header ), str.end() )
+    payload( str.begin() + header.wire_length(), str.end() )
 {}
 
 /* Fill in the send_timestamp for an outgoing message */
@@ -48,15 +123,84 @@ string put_header_field( const uint64_t n )
 		 sizeof( network_order ) );
 }
 
+/* helper to put a variable-length (base-128) field */
+string put_varint_field( uint64_t n )
+{
+  string ret;
+  while ( n >= 0x80 ) {
+    ret.push_back( char( (n & 0x7f) | 0x80 ) );
+    n >>= 7;
+  }
+  ret.push_back( char( n ) );
+  return ret;
+}
+
+/* length of a variable-length field */
+size_t varint_field_length( uint64_t n )
+{
+  size_t length = 1;
+  while ( n >= 0x80 ) {
+    n >>= 7;
+    length++;
+  }
+  return length;
+}
+
+/* helper to put a 32-bit timestamp field (in network byte order) */
+string put_timestamp_field( const uint64_t n )
+{
+  /* timestamps count milliseconds since each endpoint started,
+     so they fit in 32 bits for about 49 days */
+  const uint32_t network_order = htobe32( uint32_t( n ) );
+  return string( reinterpret_cast<const char *>( &network_order ),
+		 sizeof( network_order ) );
+}
+
 /* Make wire representation of header */
 string ContestMessage::Header::to_string( void ) const
 {
-  return put_header_field( sequence_number )
-    + put_header_field( send_timestamp )
-    + put_header_field( ack_sequence_number )
-    + put_header_field( ack_send_timestamp )
-    + put_header_field( ack_recv_timestamp )
-    + put_header_field( ack_payload_length );
+  if ( format == Format::Legacy ) {
+    return put_header_field( sequence_number )
+      + put_header_field( send_timestamp )
+      + put_header_field( ack_sequence_number )
+      + put_header_field( ack_send_timestamp )
+      + put_header_field( ack_recv_timestamp )
+      + put_header_field( ack_payload_length );
+  }
+
+  const bool has_ack = ack_sequence_number != uint64_t( -1 );
+
+  string ret( 1, char( (COMPACT_VERSION << 4)
+			| (has_ack ? FLAG_HAS_ACK | ((ack_ecn & 0x03) << ACK_ECN_SHIFT) : 0) ) );
+  ret += put_varint_field( sequence_number );
+  ret += put_timestamp_field( send_timestamp );
+
+  if ( has_ack ) {
+    ret += put_varint_field( ack_sequence_number );
+    ret += put_timestamp_field( ack_send_timestamp );
+    ret += put_timestamp_field( ack_recv_timestamp );
+    ret += put_varint_field( ack_payload_length );
+  }
+
+  return ret;
+}
+
+/* Length of the wire representation of header */
+size_t ContestMessage::Header::wire_length( void ) const
+{
+  if ( format == Format::Legacy ) {
+    return 6 * sizeof( uint64_t );
+  }
+
+  size_t length = 1 + varint_field_length( sequence_number ) + sizeof( uint32_t );
+
+  if ( ack_sequence_number != uint64_t( -1 ) ) {
+    length += varint_field_length( ack_sequence_number )
+      + 2 * sizeof( uint32_t )
+      + varint_field_length( ack_payload_length );
+  }
+
+  return length;
 }
 
 /* Make wire representation of message */
@@ -67,7 +211,8 @@ string ContestMessage::to_string( void ) const
 
 /* Transform into an ack of the ContestMessage */
 void ContestMessage::transform_into_ack( const uint64_t sequence_number,
-					 const uint64_t recv_timestamp )
+					 const uint64_t recv_timestamp,
+					 const uint8_t recv_ecn )
 {
   /* ack the old sequence number */
   header.ack_sequence_number = header.sequence_number;
@@ -79,6 +224,7 @@ void ContestMessage::transform_into_ack( const uint64_t sequence_number,
   header.ack_send_timestamp = header.send_timestamp;
   header.ack_recv_timestamp = recv_timestamp;
   header.ack_payload_length = payload.length();
+  header.ack_ecn = recv_ecn;
 
   /* delete the payload */
   payload.clear();
@@ -98,7 +244,9 @@ ContestMessage::Header::Header( const uint64_t s_sequence_number )
     ack_sequence_number( -1 ),
     ack_send_timestamp( -1 ),
     ack_recv_timestamp( -1 ),
-    ack_payload_length( -1 )
+    ack_payload_length( -1 ),
+    ack_ecn( 0 ),
+    format( Format::Legacy )
 {}
 
 /* Is this message an ack? */
@@ -106,3 +254,15 @@ bool ContestMessage::is_ack( void ) const
 {
   return header.ack_sequence_number != uint64_t( -1 );
 }
+
+/* Advertise that the receiver understands the compact format */
+void ContestMessage::offer_compact( void )
+{
+  payload = COMPACT_OFFER;
+}
+
+/* Did the peer advertise the compact format? */
+bool ContestMessage::offers_compact( void ) const
+{
+  return payload == COMPACT_OFFER;
+}
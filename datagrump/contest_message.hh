@@ -6,6 +6,12 @@
 
 struct ContestMessage
 {
+  /* Wire formats: the original header of six 64-bit fields, and a
+     compact header (version/flags byte, variable-length sequence
+     numbers, 32-bit millisecond timestamps, ack fields only on acks,
+     and on acks the ECN bits the acked datagram arrived with) */
+  enum class Format { Legacy, Compact };
+
   struct Header {
     uint64_t sequence_number;
     uint64_t send_timestamp;
@@ -14,6 +20,9 @@ struct ContestMessage
     uint64_t ack_send_timestamp;
     uint64_t ack_recv_timestamp;
     uint64_t ack_payload_length;
+    uint8_t ack_ecn; /* UDPSocket::ECN; compact acks only (else NOT_ECT) */
+
+    Format format;
 
     /* Header for new message */
     Header( const uint64_t s_sequence_number );
@@ -23,6 +32,9 @@ struct ContestMessage
 
     /* Make wire representation of header */
     std::string to_string( void ) const;
+
+    /* Length of the wire representation of header */
+    size_t wire_length( void ) const;
   } header;
 
   std::string payload;
@@ -42,10 +54,18 @@ struct ContestMessage
 
   /* Transform into an ack of the ContestMessage */
   void transform_into_ack( const uint64_t sequence_number,
-			   const uint64_t recv_timestamp );
+			   const uint64_t recv_timestamp,
+			   const uint8_t recv_ecn );
 
   /* Is this message an ack? */
   bool is_ack( void ) const;
+
+  /* Advertise (in the empty payload of a legacy ack) that the
+     receiver understands the compact format */
+  void offer_compact( void );
+
+  /* Did the peer advertise the compact format? */
+  bool offers_compact( void ) const;
 };
 
 #endif /* CONTEST_MESSAGE_HH */
@@ -1,10 +1,17 @@
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #include "controller.hh"
 #include "timestamp.hh"
 
 #define EPOCH 100
-#define TIMEOUT 90
+#define DELAY_THRESHOLD 90 /* an RTT above this means congestion */
+#define TIMEOUT 90 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
 #define AI_CONST 1.0
 #define MD_CONST 2
 #define MIN_WINDOW 1
@@ -12,6 +19,32 @@
 #define MD_RATIO_SCALER 1.5
 #define START_WINDOW 5
 #define AI_GROWTH 0.01
+#define PACING_GAIN 1.25
+#define TUNE_VARIABLE "CUSTOM_TUNE" /* set (and not 0) to tune online */
+#define TRIAL 1000 /* ms each arm is played for */
+#define TRIAL_SETTLE 250 /* ms at the start of a trial that aren't scored */
+#define EXPLORATION 0.2 /* weight of UCB1's exploration bonus */
+
+/* The tuner's arms; the first is the constants above, and the tuned
+   controller starts from it */
+static const Controller::Parameters ARMS[] = {
+  /* threshold, AI, MD, MD buffer, MD ratio scaler, AI growth */
+  { DELAY_THRESHOLD, AI_CONST, MD_CONST, MD_BUFFER_TIME, MD_RATIO_SCALER, AI_GROWTH },
+  { 60, 1.0, 2, 200, 1.5, 0.01 },   /* a tighter delay budget */
+  { 120, 1.0, 2, 200, 1.5, 0.01 },  /* a looser one, for longer paths */
+  { 180, 1.0, 2, 200, 1.5, 0.01 },
+  { 90, 2.0, 2, 200, 1.5, 0.02 },   /* faster growth */
+  { 90, 1.0, 1.5, 100, 1.2, 0.01 }, /* gentler decreases */
+  { 60, 0.5, 2, 300, 2.0, 0.005 },  /* cautious all round */
+  { 120, 2.0, 1.5, 100, 1.2, 0.02 } /* aggressive all round */
+};
+static const size_t NUM_ARMS = sizeof( ARMS ) / sizeof( ARMS[ 0 ] );
+
+static bool tuning_requested( void )
+{
+  const char * value = getenv( TUNE_VARIABLE );
+  return value and *value and strcmp( value, "0" );
+}
 
 using namespace std;
 
@@ -23,7 +56,16 @@ Controller::Controller( const bool debug ) :
   cwnd_(START_WINDOW),
   timestamp_of_mult_decrease_(timestamp_ms()),
   ai_(AI_CONST),
-  send_time_for_packet_()
+  rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+  outstanding_(),
+  slow_start_(),
+  parameters_( ARMS[ 0 ] ),
+  tuning_( tuning_requested() ),
+  tuner_( NUM_ARMS, EXPLORATION ),
+  arm_( 0 ),
+  trial_start_( timestamp_ms() ),
+  trial_acked_( 0 ),
+  trial_rtts_()
 {}
 
 /* Get current window size, in datagrams */
@@ -46,8 +88,7 @@ void Controller::datagram_was_sent( const uint64_t sequence_number,
 				    const uint64_t send_timestamp )
                                     /* in milliseconds */
 {
-  /* Default: take no action */
-  send_time_for_packet_[sequence_number] = send_timestamp;
+  outstanding_.sent(sequence_number, send_timestamp);
 
   if ( debug_ ) {
     cerr << "At time " << send_timestamp
@@ -56,14 +97,16 @@ void Controller::datagram_was_sent( const uint64_t sequence_number,
 }
 
 void Controller::additive_increase() {
-  ai_ += AI_GROWTH;
+  ai_ += parameters_.ai_growth;
   cwnd_ += (1.0 * ai_) / cwnd_;
 }
 
 void Controller::multiplicative_decrease(double md_const) {
+  slow_start_.lost();
+
   // If we have recently done a multiplicative decrease, don't do anything.
-  ai_ = AI_CONST;
-  if (timestamp_ms() - timestamp_of_mult_decrease_ < MD_BUFFER_TIME){
+  ai_ = parameters_.ai_const;
+  if (timestamp_ms() - timestamp_of_mult_decrease_ < parameters_.md_buffer_time){
     return;
   }
 
@@ -73,31 +116,54 @@ void Controller::multiplicative_decrease(double md_const) {
 }
 
 void Controller::multiplicative_decrease() {
-  multiplicative_decrease(MD_CONST);
+  multiplicative_decrease(parameters_.md_const);
 }
 
 void Controller::purge_outstanding_packets() {
-  size_t num_outstanding = 0;
   uint64_t now = timestamp_ms();
-  double ratio;
-  double max_ratio = 1;
-  std::vector<uint64_t> outstanding_packets;
-  for (auto &entry : send_time_for_packet_) {
-    if (now - entry.second > timeout_ms()) {
-      ratio = ((double)(now - entry.second)) /  timeout_ms() * MD_RATIO_SCALER;
-      outstanding_packets.push_back(entry.first);
-      max_ratio = std::max(max_ratio, ratio);
-      num_outstanding++;
-    }
+
+  // Packets are sent in order, so the oldest outstanding packet has waited
+  // the longest. If it hasn't timed out, nothing has.
+  if (outstanding_.empty() ||
+      now - outstanding_.oldest_send_timestamp() <= parameters_.delay_threshold) {
+    return;
   }
 
-  if (num_outstanding != 0) {
-    multiplicative_decrease(max_ratio);
-  }  
+  double ratio = ((double)(now - outstanding_.oldest_send_timestamp())) / parameters_.delay_threshold * parameters_.md_ratio_scaler;
+  double max_ratio = std::max(1.0, ratio);
 
-  for (auto seq : outstanding_packets) {
-    send_time_for_packet_.erase(seq);
+  while (!outstanding_.empty() &&
+         now - outstanding_.oldest_send_timestamp() > parameters_.delay_threshold) {
+    outstanding_.pop_oldest();
   }
+
+  multiplicative_decrease(max_ratio);
+}
+
+/* Score the arm just played by the contest's power (throughput over
+   95th-percentile delay, here the RTT, as the acks show them) and pick
+   the next one */
+void Controller::end_trial( const uint64_t now ) {
+  double power = 0;
+  if (!trial_rtts_.empty()) {
+    auto p95 = trial_rtts_.begin() + trial_rtts_.size() * 95 / 100;
+    nth_element(trial_rtts_.begin(), p95, trial_rtts_.end());
+    const double throughput = trial_acked_ * 1000.0 / (now - trial_start_ - TRIAL_SETTLE);
+    power = throughput / std::max(1.0, *p95);
+  }
+  tuner_.reward(arm_, power);
+
+  const size_t next_arm = tuner_.choose();
+  cerr << "At time " << now << " custom tuner: arm " << arm_
+       << " scored " << power << " (mean " << tuner_.mean(arm_)
+       << " over " << tuner_.pulls(arm_) << " trials), next arm " << next_arm
+       << " (best so far " << tuner_.best() << ")" << endl;
+
+  arm_ = next_arm;
+  parameters_ = ARMS[arm_];
+  trial_start_ = now;
+  trial_acked_ = 0;
+  trial_rtts_.clear();
 }
 
 /* An ack was received */
@@ -111,19 +177,34 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
                                /* when the ack was received (by sender) */
 {
   double rtt = timestamp_ack_received - send_timestamp_acked;
+  rtt_estimator_.sample( rtt, timestamp_ack_received );
   double ratio = 1;
-  ratio = std::max(ratio, rtt / timeout_ms()) * 1.5;
+  ratio = std::max(ratio, rtt / parameters_.delay_threshold) * parameters_.md_ratio_scaler;
 
-  if (send_time_for_packet_.find(sequence_number_acked) != 
-      send_time_for_packet_.end()) {
-    if (rtt < timeout_ms()) {
+  if (outstanding_.acked(sequence_number_acked)) {
+    if (rtt < parameters_.delay_threshold && slow_start_.active()) {
+      cwnd_ += slow_start_.acked(cwnd_, send_timestamp_acked, rtt,
+                                 rtt_estimator_.min_rtt(), timestamp_ack_received);
+      if (!slow_start_.active() && debug_) {
+        cerr << "At time " << timestamp_ack_received << " leaving slow start ("
+             << slow_start_.exit_name() << ") at window " << cwnd_ << endl;
+      }
+    } else if (rtt < parameters_.delay_threshold) {
       additive_increase();
     } else {
       multiplicative_decrease(ratio);
     }
   } 
 
-  send_time_for_packet_.erase(sequence_number_acked);
+  if (tuning_) {
+    if (timestamp_ack_received - trial_start_ >= TRIAL_SETTLE) {
+      trial_acked_++;
+      trial_rtts_.push_back(rtt);
+    }
+    if (timestamp_ack_received - trial_start_ >= TRIAL) {
+      end_trial(timestamp_ack_received);
+    }
+  }
 
   if ( debug_ ) {
     cerr << "At time " << timestamp_ack_received
@@ -134,9 +215,108 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
   }
 }
 
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Losses among packets we are still tracking mean congestion */
+  if ( outstanding_.lost( sequence_number ) ) {
+    multiplicative_decrease();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  slow_start_.delivery_rate_sampled( sample );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
 /* How long to wait (in milliseconds) if there are no acks
    before sending one more datagram */
 unsigned int Controller::timeout_ms( void )
 {
-  return TIMEOUT; /* timeout of one second */
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip */
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* paced acks arrive spread out, so an ack train must last longer */
+  slow_start_.set_paced( paced );
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
+
+/* Take over from another controller at the window it left */
+void Controller::set_window( const double window )
+{
+  cwnd_ = max( 1.0, window );
+  slow_start_.skip();
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms() << " taking over at window " << window << endl;
+  }
 }
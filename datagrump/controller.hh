@@ -8,10 +8,27 @@
 #include <ctime>
 #include <cmath>
 #include <deque>
-#include <unordered_map>
+
+#include "outstanding_packets.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "bandit.hh"
+#include "slow_start.hh"
 
 class Controller
 {
+public:
+  /* The constants the window follows: one of the tuner's arms */
+  struct Parameters {
+    double delay_threshold; /* an RTT above this (ms) means congestion */
+    double ai_const;        /* additive increase just after a decrease */
+    double md_const;        /* divides the window on a loss */
+    double md_buffer_time;  /* ms after a decrease with no further decrease */
+    double md_ratio_scaler; /* scales a delay-triggered decrease */
+    double ai_growth;       /* the increase grows by this per ack */
+  };
+
 private:
   bool debug_; /* Enables debugging output */
 
@@ -21,7 +38,22 @@ private:
   double cwnd_;
   uint64_t timestamp_of_mult_decrease_;
   double ai_;
-  std::unordered_map<uint64_t, uint64_t> send_time_for_packet_;
+  RttEstimator rtt_estimator_; /* for the timeout */
+  OutstandingPackets outstanding_;
+  SlowStart slow_start_; /* grows the window until the first congestion signal */
+
+  Parameters parameters_;
+
+  /* online tuning (with $CUSTOM_TUNE set): each trial plays one arm
+     and is scored by the power its acks show */
+  bool tuning_;
+  UcbBandit tuner_;
+  size_t arm_;
+  uint64_t trial_start_;
+  uint64_t trial_acked_;
+  std::vector<double> trial_rtts_;
+
+  void end_trial( const uint64_t now );
 public:
   /* Public interface for the congestion controller */
   /* You can change these if you prefer, but will need to change
@@ -43,10 +75,38 @@ public:
 		     const uint64_t recv_timestamp_acked,
 		     const uint64_t timestamp_ack_received );
 
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
   /* How long to wait (in milliseconds) if there are no acks
      before sending one more datagram */
   unsigned int timeout_ms( void );
 
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+
+  /* Take over from another controller at the window it left */
+  void set_window( const double window );
+
   void purge_outstanding_packets();
 
   void multiplicative_decrease();
@@ -1,18 +1,26 @@
 #include <iostream>
+#include <algorithm>
 
 #include "controller.hh"
 #include "timestamp.hh"
 
-#define TIMEOUT 100
+#define DELAY_THRESHOLD 100 /* an RTT above this means congestion */
+#define TIMEOUT 100 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
 #define AI_CONST 1.5
 #define MD_CONST 0.8
 #define MIN_WINDOW 1.0
+#define PACING_GAIN 1.25
 
 using namespace std;
 
 /* Default constructor */
 Controller::Controller( const bool debug )
-  : debug_( debug ), cwnd_( MIN_WINDOW )
+  : debug_( debug ), cwnd_( MIN_WINDOW ), rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    timestamp_of_last_md_( 0 ),
+    slow_start_()
 {}
 
 /* Get current window size, in datagrams */
@@ -32,7 +40,9 @@ void Controller::additive_increase() {
 }
 
 void Controller::multiplicative_decrease() {
+  slow_start_.lost();
   cwnd_= max(cwnd_ * MD_CONST, MIN_WINDOW);
+  timestamp_of_last_md_ = timestamp_ms();
 }
 
 /* A datagram was sent */
@@ -59,9 +69,23 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
 			       const uint64_t timestamp_ack_received )
                                /* when the ack was received (by sender) */
 {
-  // We'll assume we had packet loss if the packet took more than timeout_ms().
-  if (timestamp_ack_received - send_timestamp_acked < timeout_ms()) {
-    additive_increase();
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+
+  const double rtt = timestamp_ack_received - send_timestamp_acked;
+
+  // We'll assume we had packet loss if the packet took more than DELAY_THRESHOLD.
+  if (rtt < DELAY_THRESHOLD) {
+    if ( slow_start_.active() ) {
+      cwnd_ += slow_start_.acked( cwnd_, send_timestamp_acked, rtt,
+				  rtt_estimator_.min_rtt(), timestamp_ack_received );
+      if ( not slow_start_.active() and debug_ ) {
+	cerr << "At time " << timestamp_ack_received << " leaving slow start ("
+	     << slow_start_.exit_name() << ") at window " << cwnd_ << endl;
+      }
+    } else {
+      additive_increase();
+    }
   }  else {
     multiplicative_decrease();
   }
@@ -75,9 +99,109 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
   }
 }
 
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Back off once per window of data: only losses of datagrams sent
+     after the last decrease count */
+  if ( send_timestamp > timestamp_of_last_md_ ) {
+    multiplicative_decrease();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  slow_start_.delivery_rate_sampled( sample );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
 /* How long to wait (in milliseconds) if there are no acks
    before sending one more datagram */
 unsigned int Controller::timeout_ms( void )
 {
-  return TIMEOUT; /* timeout of one second */
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip */
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* paced acks arrive spread out, so an ack train must last longer */
+  slow_start_.set_paced( paced );
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
+
+/* Take over from another controller at the window it left */
+void Controller::set_window( const double window )
+{
+  cwnd_ = max( 1.0, window );
+  slow_start_.skip();
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms() << " taking over at window " << window << endl;
+  }
 }
@@ -0,0 +1,304 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define MODEL_VARIABLE "AURORA_MODEL" /* names a network file to load */
+#define HISTORY 10 /* monitor intervals the policy sees */
+#define FEATURES 3
+#define GRADIENT 0      /* feature offsets within an interval */
+#define LATENCY_RATIO 1
+#define SEND_RATIO 2
+#define MAX_FEATURE 10.0
+#define ACTION_SCALE 0.025 /* Aurora's alpha */
+#define START_RATE 100.0 /* datagrams per second */
+#define MIN_RATE 20.0
+#define MAX_RATE 100000.0
+#define START_WINDOW 10
+#define MIN_CWND 2.0
+#define WINDOW_GAIN 2.0 /* the window only caps the rate: two BDPs at it */
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Used when $AURORA_MODEL is unset: a hand-set network over the newest
+   interval only. Three hidden units flag a rising RTT, an RTT well
+   above its minimum and sending faster than acks return; the output
+   grows the rate unless they fire. */
+static Mlp default_policy( void )
+{
+  const size_t inputs = HISTORY * FEATURES;
+  vector<float> hidden( 3 * inputs, 0 );
+  hidden[ 0 * inputs + GRADIENT ] = 10;
+  hidden[ 1 * inputs + LATENCY_RATIO ] = 5;
+  hidden[ 2 * inputs + SEND_RATIO ] = 5;
+
+  Mlp policy;
+  policy.add_layer( inputs, 3, hidden, { 0, -5 * 1.25, -5 * 1.1 } );
+  policy.add_layer( 3, 1, { -6, -8, -4 }, { 2 } );
+  return policy;
+}
+
+/* The network named by $AURORA_MODEL, or the default */
+static Mlp load_policy( void )
+{
+  const char * path = getenv( MODEL_VARIABLE );
+  Mlp policy = path ? Mlp::load( path ) : default_policy();
+
+  if ( policy.inputs() != HISTORY * FEATURES or policy.outputs() != 1 ) {
+    throw runtime_error( "aurora: the policy must map " + to_string( HISTORY * FEATURES )
+			 + " inputs to 1 output" );
+  }
+
+  return policy;
+}
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    policy_( load_policy() ),
+    history_(),
+    min_latency_( MIN_RTT_WINDOW ),
+    rate_( START_RATE ),
+    interval_start_( 0 ),
+    interval_sent_( 0 ),
+    interval_acked_( 0 ),
+    rtt_samples_( 0 ),
+    sum_time_( 0 ),
+    sum_rtt_( 0 ),
+    sum_time_squared_( 0 ),
+    sum_time_rtt_( 0 )
+{
+  /* before any intervals: a flat, empty path */
+  for ( unsigned int interval = 0; interval < HISTORY; interval++ ) {
+    history_.insert( history_.end(), { 0, 1, 1 } );
+  }
+
+  if ( debug_ ) {
+    cerr << "Policy kernel: " << int( policy_.kernel() ) << endl;
+  }
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = START_WINDOW;
+  if ( rtt_estimator_.has_sample() ) {
+    the_window_size = max( MIN_CWND, WINDOW_GAIN * rate_ * rtt_estimator_.min_rtt() / 1000.0 );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  interval_sent_++;
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+void Controller::start_interval( const uint64_t now )
+{
+  interval_start_ = now;
+  interval_sent_ = interval_acked_ = 0;
+  rtt_samples_ = sum_time_ = sum_rtt_ = sum_time_squared_ = sum_time_rtt_ = 0;
+}
+
+/* Summarize the interval, push it onto the history and let the policy
+   move the rate */
+void Controller::end_interval( const uint64_t now )
+{
+  const double mean_rtt = sum_rtt_ / rtt_samples_;
+  const double min_latency = min_latency_.update( mean_rtt, now );
+
+  /* least-squares slope of RTT against ack time */
+  double gradient = 0;
+  const double denominator = rtt_samples_ * sum_time_squared_ - sum_time_ * sum_time_;
+  if ( rtt_samples_ >= 2 and denominator > 0 ) {
+    gradient = (rtt_samples_ * sum_time_rtt_ - sum_time_ * sum_rtt_) / denominator;
+  }
+
+  history_.pop_back();
+  history_.pop_back();
+  history_.pop_back();
+  history_.insert( history_.begin(), {
+      float( max( -MAX_FEATURE, min( MAX_FEATURE, gradient ) ) ),
+      float( min( MAX_FEATURE, mean_rtt / max( 1.0, min_latency ) ) ),
+      float( min( MAX_FEATURE, double( interval_sent_ ) / interval_acked_ ) ) } );
+
+  /* the policy's cost is only timed for the debug log */
+  chrono::steady_clock::time_point begin;
+  if ( debug_ ) {
+    begin = chrono::steady_clock::now();
+  }
+  const double action = policy_.evaluate( history_ )[ 0 ];
+  chrono::steady_clock::duration elapsed {};
+  if ( debug_ ) {
+    elapsed = chrono::steady_clock::now() - begin;
+  }
+
+  rate_ = action >= 0 ? rate_ * (1 + ACTION_SCALE * action)
+                      : rate_ / (1 - ACTION_SCALE * action);
+  rate_ = max( MIN_RATE, min( MAX_RATE, rate_ ) );
+
+  if ( debug_ ) {
+    cerr << "At time " << now
+	 << " interval: gradient " << history_[ GRADIENT ]
+	 << ", latency ratio " << history_[ LATENCY_RATIO ]
+	 << ", send ratio " << history_[ SEND_RATIO ]
+	 << "; action " << action << " (in "
+	 << chrono::duration_cast<chrono::nanoseconds>( elapsed ).count() << " ns)"
+	 << ", rate " << rate_ << " datagrams/s" << endl;
+  }
+
+  start_interval( now );
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const double rtt = timestamp_ack_received - send_timestamp_acked;
+  rtt_estimator_.sample( rtt, timestamp_ack_received );
+
+  if ( interval_start_ == 0 ) {
+    start_interval( timestamp_ack_received );
+  }
+
+  const double time = double( timestamp_ack_received - interval_start_ );
+  interval_acked_++;
+  rtt_samples_++;
+  sum_time_ += time;
+  sum_rtt_ += rtt;
+  sum_time_squared_ += time * time;
+  sum_time_rtt_ += time * rtt;
+
+  if ( timestamp_ack_received >= interval_start_ + rtt_estimator_.srtt() ) {
+    end_interval( timestamp_ack_received );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Default: take no action (the send ratio reflects losses) */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* the interval in progress can't be summarized fairly: halve the
+     rate and start a new one with the next ack */
+  rate_ = max( MIN_RATE, rate_ / 2 );
+  interval_start_ = 0;
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  return rate_;
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
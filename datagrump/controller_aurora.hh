@@ -0,0 +1,88 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "mlp.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+  RttEstimator rtt_estimator_;
+
+  Mlp policy_;
+  std::vector<float> history_; /* per monitor interval, newest first:
+				  latency gradient, latency ratio, send ratio */
+  WindowedMinFilter min_latency_; /* least mean RTT of an interval */
+  double rate_; /* datagrams per second */
+
+  /* the current monitor interval (about a smoothed RTT of acks) */
+  uint64_t interval_start_;
+  uint64_t interval_sent_, interval_acked_;
+  double rtt_samples_, sum_time_, sum_rtt_, sum_time_squared_, sum_time_rtt_;
+
+  void start_interval( const uint64_t now );
+  void end_interval( const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include <iostream>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define HIGH_GAIN 2.885 /* 2/ln(2): doubles the sending rate every round trip */
+#define DRAIN_GAIN (1 / HIGH_GAIN)
+#define CWND_GAIN 2.0
+#define START_WINDOW 10
+#define MIN_CWND 4
+#define BANDWIDTH_WINDOW 5 /* round trips */
+#define MIN_RTT_WINDOW 10000
+#define PROBE_RTT_TIME 200
+#define FULL_BANDWIDTH_GROWTH 1.25
+#define FULL_BANDWIDTH_ROUNDS 3
+#define CYCLE_LENGTH 8
+#define QUEUE_LIMIT 10 /* ms of queueing delay the model tolerates */
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+
+using namespace std;
+
+/* ProbeBandwidth pacing gains: probe for more bandwidth for a round
+   trip, drain the queue that made for a round trip, then cruise */
+static const double CYCLE_GAINS[ CYCLE_LENGTH ] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    mode_( Mode::Startup ),
+    max_bandwidth_( BANDWIDTH_WINDOW ),
+    min_rtt_( MIN_RTT_WINDOW ),
+    min_rtt_timestamp_( 0 ),
+    queue_building_( false ),
+    latest_bandwidth_( 0 ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    delivered_( 0 ),
+    round_count_( 0 ),
+    next_round_delivered_( 0 ),
+    round_start_( false ),
+    full_bandwidth_( 0 ),
+    full_bandwidth_count_( 0 ),
+    filled_pipe_( false ),
+    pacing_gain_( HIGH_GAIN ),
+    cwnd_gain_( HIGH_GAIN ),
+    cycle_index_( 0 ),
+    cycle_timestamp_( 0 ),
+    lost_since_cycle_start_( false ),
+    probe_rtt_done_timestamp_( 0 ),
+    probe_rtt_round_done_( false ),
+    datagrams_in_flight_( 0 )
+{}
+
+/* The estimated bottleneck bandwidth, in datagrams per second */
+double Controller::bandwidth( void ) const
+{
+  /* a cellular link's rate can fall far faster than the max filter
+     forgets, so don't keep sending at a rate that is building a queue */
+  if ( queue_building_ ) {
+    return min( max_bandwidth_.get(), latest_bandwidth_ );
+  }
+
+  return max_bandwidth_.get();
+}
+
+/* The estimated bandwidth-delay product (in datagrams), scaled by gain */
+double Controller::bdp( const double gain ) const
+{
+  if ( not max_bandwidth_.has_value() or not min_rtt_.has_value() ) {
+    return START_WINDOW;
+  }
+
+  return gain * bandwidth() * min_rtt_.get() / 1000.0;
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size;
+
+  if ( mode_ == Mode::ProbeRtt ) {
+    the_window_size = MIN_CWND;
+  } else {
+    /* no headroom for a queue that is already standing */
+    const double gain = queue_building_ ? 1 : cwnd_gain_;
+    the_window_size = max( (unsigned int) bdp( gain ), (unsigned int) MIN_CWND );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  /* The model is updated from the delivery-rate sample that follows */
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  datagrams_in_flight_ = datagrams_in_flight;
+  check_drain( timestamp_ms() );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* The model ignores losses, except to end a bandwidth probe early */
+  lost_since_cycle_start_ = true;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A round trip ends when a datagram sent after it began is delivered */
+void Controller::update_round( const RateSample & sample )
+{
+  delivered_ = sample.prior_delivered + sample.delivered;
+
+  round_start_ = false;
+  if ( sample.prior_delivered >= next_round_delivered_ ) {
+    next_round_delivered_ = delivered_;
+    round_count_++;
+    round_start_ = true;
+  }
+}
+
+void Controller::update_bandwidth( const RateSample & sample )
+{
+  latest_bandwidth_ = sample.delivery_rate;
+  queue_building_ = min_rtt_.has_value()
+    and sample.rtt > min_rtt_.get() + QUEUE_LIMIT;
+
+  max_bandwidth_.update( sample.delivery_rate, round_count_ );
+}
+
+/* Startup has filled the pipe once bandwidth grows less than 25%
+   over three round trips */
+void Controller::check_full_pipe( void )
+{
+  if ( filled_pipe_ or not round_start_ ) {
+    return;
+  }
+
+  if ( max_bandwidth_.get() >= full_bandwidth_ * FULL_BANDWIDTH_GROWTH ) {
+    full_bandwidth_ = max_bandwidth_.get();
+    full_bandwidth_count_ = 0;
+    return;
+  }
+
+  if ( ++full_bandwidth_count_ >= FULL_BANDWIDTH_ROUNDS ) {
+    filled_pipe_ = true;
+  }
+}
+
+/* Drain the queue Startup built, then probe for bandwidth */
+void Controller::check_drain( const uint64_t now )
+{
+  if ( mode_ == Mode::Startup and filled_pipe_ ) {
+    mode_ = Mode::Drain;
+    pacing_gain_ = DRAIN_GAIN;
+    cwnd_gain_ = HIGH_GAIN;
+  }
+
+  if ( mode_ == Mode::Drain and datagrams_in_flight_ <= bdp( 1 ) ) {
+    enter_probe_bandwidth( now );
+  }
+}
+
+void Controller::enter_probe_bandwidth( const uint64_t now )
+{
+  mode_ = Mode::ProbeBandwidth;
+  cwnd_gain_ = CWND_GAIN;
+
+  /* start anywhere in the cycle but the draining phase */
+  cycle_index_ = (2 + now % (CYCLE_LENGTH - 1)) % CYCLE_LENGTH;
+  cycle_timestamp_ = now;
+  lost_since_cycle_start_ = false;
+  pacing_gain_ = CYCLE_GAINS[ cycle_index_ ];
+}
+
+/* Each phase of the gain cycle lasts about one minimum RTT */
+void Controller::advance_cycle_phase( const uint64_t now )
+{
+  if ( mode_ != Mode::ProbeBandwidth ) {
+    return;
+  }
+
+  const bool full_length = now - cycle_timestamp_ > min_rtt_.get();
+  bool advance = full_length;
+
+  if ( pacing_gain_ > 1 ) {
+    /* keep probing until the extra data is actually in flight */
+    advance = full_length and ( lost_since_cycle_start_
+				or datagrams_in_flight_ >= bdp( pacing_gain_ ) );
+  } else if ( pacing_gain_ < 1 ) {
+    /* stop draining as soon as the queue is gone */
+    advance = full_length or datagrams_in_flight_ <= bdp( 1 );
+  }
+
+  if ( advance ) {
+    cycle_index_ = (cycle_index_ + 1) % CYCLE_LENGTH;
+    cycle_timestamp_ = now;
+    lost_since_cycle_start_ = false;
+    pacing_gain_ = CYCLE_GAINS[ cycle_index_ ];
+  }
+}
+
+/* If the minimum RTT hasn't been seen again for the whole window, cut
+   the window to a few datagrams for a moment to measure it afresh */
+void Controller::update_min_rtt( const RateSample & sample, const uint64_t now )
+{
+  const bool expired = min_rtt_.has_value()
+    and now - min_rtt_timestamp_ > MIN_RTT_WINDOW;
+
+  if ( not min_rtt_.has_value() or sample.rtt <= min_rtt_.get() or expired ) {
+    min_rtt_timestamp_ = now;
+  }
+  min_rtt_.update( sample.rtt, now );
+
+  if ( expired and mode_ != Mode::ProbeRtt ) {
+    mode_ = Mode::ProbeRtt;
+    pacing_gain_ = 1;
+    cwnd_gain_ = 1;
+    probe_rtt_done_timestamp_ = 0;
+  }
+
+  if ( mode_ == Mode::ProbeRtt ) {
+    if ( probe_rtt_done_timestamp_ == 0 and datagrams_in_flight_ <= MIN_CWND ) {
+      probe_rtt_done_timestamp_ = now + PROBE_RTT_TIME;
+      probe_rtt_round_done_ = false;
+      next_round_delivered_ = delivered_;
+    } else if ( probe_rtt_done_timestamp_ ) {
+      if ( round_start_ ) {
+	probe_rtt_round_done_ = true;
+      }
+      if ( probe_rtt_round_done_ and now > probe_rtt_done_timestamp_ ) {
+	min_rtt_timestamp_ = now;
+	if ( filled_pipe_ ) {
+	  enter_probe_bandwidth( now );
+	} else {
+	  mode_ = Mode::Startup;
+	  pacing_gain_ = cwnd_gain_ = HIGH_GAIN;
+	}
+      }
+    }
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  const uint64_t now = timestamp_ms();
+
+  update_round( sample );
+  update_bandwidth( sample );
+  advance_cycle_phase( now );
+  check_full_pipe();
+  check_drain( now );
+  update_min_rtt( sample, now );
+
+  if ( debug_ ) {
+    cerr << "At time " << now
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)"
+	 << "; model: " << max_bandwidth_.get() << " datagrams/s, "
+	 << min_rtt_.get() << " ms, mode " << int( mode_ ) << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Before the first bandwidth sample, pace the initial window
+     over the smoothed RTT */
+  if ( not max_bandwidth_.has_value() ) {
+    if ( rtt_estimator_.srtt() <= 0 ) {
+      return 0;
+    }
+    return pacing_gain_ * START_WINDOW * 1000.0 / rtt_estimator_.srtt();
+  }
+
+  return pacing_gain_ * bandwidth();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+  enum class Mode { Startup, Drain, ProbeBandwidth, ProbeRtt };
+  Mode mode_;
+
+  /* the path model: bottleneck bandwidth (datagrams per second, max over
+     recent round trips) and round-trip propagation delay (ms, min over
+     recent seconds) */
+  WindowedMaxFilter max_bandwidth_;
+  WindowedMinFilter min_rtt_;
+  uint64_t min_rtt_timestamp_; /* when min_rtt_ last fell (or was refreshed) */
+
+  /* while the RTT shows a standing queue, the latest delivery rate
+     stands in for the (lagging) max filter */
+  bool queue_building_;
+  double latest_bandwidth_;
+
+  RttEstimator rtt_estimator_; /* for the timeout */
+
+  /* round trips, counted by delivered datagrams */
+  uint64_t delivered_;
+  uint64_t round_count_;
+  uint64_t next_round_delivered_;
+  bool round_start_;
+
+  /* Startup ends when bandwidth stops growing */
+  double full_bandwidth_;
+  unsigned int full_bandwidth_count_;
+  bool filled_pipe_;
+
+  double pacing_gain_;
+  double cwnd_gain_;
+  unsigned int cycle_index_;     /* phase of the ProbeBandwidth gain cycle */
+  uint64_t cycle_timestamp_;     /* when the phase began */
+  bool lost_since_cycle_start_;
+
+  uint64_t probe_rtt_done_timestamp_; /* 0 until in flight has drained */
+  bool probe_rtt_round_done_;
+
+  uint64_t datagrams_in_flight_;
+
+  double bandwidth( void ) const;
+  double bdp( const double gain ) const;
+  void update_round( const RateSample & sample );
+  void update_bandwidth( const RateSample & sample );
+  void check_full_pipe( void );
+  void check_drain( const uint64_t now );
+  void advance_cycle_phase( const uint64_t now );
+  void update_min_rtt( const RateSample & sample, const uint64_t now );
+  void enter_probe_bandwidth( const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
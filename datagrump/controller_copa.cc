@@ -0,0 +1,270 @@
+#include <iostream>
+#include <algorithm>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define DELTA 0.5 /* default mode: at most 1/DELTA datagrams queued per flow */
+#define START_CWND 10.0
+#define MIN_CWND 2.0
+#define VELOCITY_ROUNDS 3 /* round trips in one direction before velocity doubles */
+#define EMPTY_QUEUE_FRACTION 0.1
+#define MAX_RTT_ROUNDS 4 /* window of the max RTT, in smoothed RTTs */
+#define COMPETITIVE_ROUNDS 5 /* without a nearly empty queue, in smoothed RTTs */
+#define PACING_GAIN 2.0
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    standing_rtt_( 1 ),
+    max_rtt_( 1 ),
+    cwnd_( START_CWND ),
+    slow_start_( true ),
+    velocity_( 1 ),
+    direction_( 0 ),
+    same_direction_rounds_( 0 ),
+    round_start_cwnd_( START_CWND ),
+    round_start_timestamp_( 0 ),
+    competitive_( false ),
+    inverse_delta_( 1 / DELTA ),
+    last_empty_queue_timestamp_( timestamp_ms() ),
+    lost_this_round_( false )
+{}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = (unsigned int) cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* Once per round trip: move the velocity and, against cross traffic,
+   delta */
+void Controller::end_round( const uint64_t now )
+{
+  const int direction = cwnd_ > round_start_cwnd_ ? 1 : -1;
+
+  if ( direction == direction_ ) {
+    same_direction_rounds_++;
+    if ( same_direction_rounds_ >= VELOCITY_ROUNDS ) {
+      velocity_ *= 2;
+    }
+  } else {
+    velocity_ = 1;
+    same_direction_rounds_ = 0;
+  }
+  direction_ = direction;
+
+  /* competitive mode: AIMD on 1/delta, as a buffer-filling flow would
+     on its window */
+  if ( competitive_ ) {
+    inverse_delta_ = lost_this_round_ ? max( 1 / DELTA, inverse_delta_ / 2 )
+                                      : inverse_delta_ + 1;
+  }
+
+  lost_this_round_ = false;
+  round_start_cwnd_ = cwnd_;
+  round_start_timestamp_ = now;
+}
+
+/* Copa drains the queue it builds every few round trips. If the queue
+   has not been nearly empty for that long, someone else is filling the
+   buffer, and keeping delay low would only hand them the link. */
+void Controller::update_mode( const double rtt, const double standing_rtt,
+			      const uint64_t now )
+{
+  const double srtt = rtt_estimator_.srtt();
+  const double min_rtt = rtt_estimator_.min_rtt();
+
+  max_rtt_.set_window( max( 1.0, MAX_RTT_ROUNDS * srtt ) );
+  const double max_rtt = max_rtt_.update( rtt, now );
+
+  if ( standing_rtt - min_rtt <= EMPTY_QUEUE_FRACTION * (max_rtt - min_rtt) ) {
+    last_empty_queue_timestamp_ = now;
+  }
+
+  const bool competitive = now - last_empty_queue_timestamp_ > COMPETITIVE_ROUNDS * srtt;
+  if ( competitive_ and not competitive ) {
+    inverse_delta_ = 1 / DELTA;
+  }
+  competitive_ = competitive;
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const uint64_t now = timestamp_ack_received;
+  const double rtt = timestamp_ack_received - send_timestamp_acked;
+
+  rtt_estimator_.sample( rtt, now );
+  standing_rtt_.set_window( max( 1.0, rtt_estimator_.srtt() / 2 ) );
+  const double standing_rtt = standing_rtt_.update( rtt, now );
+  const double queueing_delay = standing_rtt - rtt_estimator_.min_rtt();
+
+  update_mode( rtt, standing_rtt, now );
+
+  /* the target rate is 1/(delta * queueing delay); the current rate is
+     cwnd/standing RTT. Compare without dividing, since the queueing
+     delay is often 0 ms. */
+  const bool below_target = cwnd_ * delta() * queueing_delay <= standing_rtt;
+
+  if ( slow_start_ and below_target ) {
+    cwnd_ += 1; /* doubles every round trip */
+  } else {
+    slow_start_ = false;
+    const double step = velocity_ / (delta() * cwnd_);
+    cwnd_ = below_target ? cwnd_ + step : cwnd_ - step;
+  }
+
+  if ( cwnd_ < MIN_CWND ) {
+    cwnd_ = MIN_CWND;
+    velocity_ = 1;
+  }
+
+  if ( send_timestamp_acked >= round_start_timestamp_ ) {
+    end_round( now );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << "; standing RTT " << standing_rtt << " ms, queueing " << queueing_delay
+	 << " ms, velocity " << velocity_ << ", delta " << delta()
+	 << ( competitive_ ? " (competitive)" : "" ) << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Copa reacts to delay, not loss; only competitive mode's delta
+     backs off */
+  lost_this_round_ = true;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* nothing is known about the rate any more: start over */
+  cwnd_ = MIN_CWND;
+  velocity_ = 1;
+  slow_start_ = true;
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Copa paces at twice its window per standing RTT, so datagrams
+     don't leave in bursts that would look like queueing */
+  if ( not standing_rtt_.has_value() or standing_rtt_.get() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / standing_rtt_.get();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
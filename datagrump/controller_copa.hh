@@ -0,0 +1,101 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+
+  /* the path's delay: propagation (min RTT over 10 seconds) and
+     standing (min RTT over the last half smoothed RTT, which filters
+     out ack compression and jitter) */
+  RttEstimator rtt_estimator_;
+  WindowedMinFilter standing_rtt_;
+  WindowedMaxFilter max_rtt_; /* over the competitive-mode check window */
+
+  double cwnd_;
+  bool slow_start_;
+
+  /* velocity: how many datagrams per round trip the window moves,
+     doubling while it keeps moving the same way */
+  double velocity_;
+  int direction_;           /* +1 up, -1 down, over the last round trip */
+  unsigned int same_direction_rounds_;
+  double round_start_cwnd_;
+  uint64_t round_start_timestamp_; /* a round ends with the ack of a datagram sent after this */
+
+  /* delta is how many round trips' worth of queueing the target rate
+     tolerates; against buffer-filling cross traffic 1/delta grows (delta
+     shrinks), making Copa more aggressive */
+  bool competitive_;
+  double inverse_delta_;
+  uint64_t last_empty_queue_timestamp_; /* when the queue was last nearly empty */
+  bool lost_this_round_;
+
+  double delta( void ) const { return 1 / inverse_delta_; }
+  void end_round( const uint64_t now );
+  void update_mode( const double rtt, const double standing_rtt, const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
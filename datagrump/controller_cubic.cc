@@ -0,0 +1,247 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define CUBIC_C 0.4
+#define CUBIC_BETA 0.7
+#define INITIAL_WINDOW 10.0
+#define MIN_WINDOW 2.0
+#define MAX_GROWTH 1.5 /* the cubic target is at most this times the window */
+#define SLOW_START_PACING_GAIN 2.0
+#define PACING_GAIN 1.2
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    cwnd_( INITIAL_WINDOW ),
+    ssthresh_( numeric_limits<double>::infinity() ),
+    epoch_start_( 0 ),
+    w_max_( 0 ),
+    k_( 0 ),
+    w_est_( 0 ),
+    timestamp_of_last_md_( 0 ),
+    slow_start_()
+{}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = (unsigned int) cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* Congestion avoidance (RFC 9438): grow towards the cubic's value one
+   RTT from now, but never slower than Reno would */
+void Controller::cubic_update( const uint64_t now )
+{
+  if ( epoch_start_ == 0 ) {
+    epoch_start_ = now;
+    k_ = cwnd_ < w_max_ ? cbrt( (w_max_ - cwnd_) / CUBIC_C ) : 0;
+    w_max_ = max( w_max_, cwnd_ );
+    w_est_ = cwnd_;
+  }
+
+  const double t = (now - epoch_start_ + rtt_estimator_.srtt()) / 1000.0;
+  const double target = min( MAX_GROWTH * cwnd_,
+			     CUBIC_C * pow( t - k_, 3 ) + w_max_ );
+
+  /* Reno's growth with CUBIC's beta: 3(1 - beta)/(1 + beta) per RTT */
+  w_est_ += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) / cwnd_;
+
+  if ( w_est_ > cwnd_ ) {
+    cwnd_ = w_est_;
+  } else if ( target > cwnd_ ) {
+    cwnd_ += (target - cwnd_) / cwnd_;
+  } else {
+    cwnd_ += 0.01 / cwnd_; /* near w_max: probe very slowly */
+  }
+}
+
+/* Back off, and remember where the window was for the next epoch */
+void Controller::multiplicative_decrease( const uint64_t now )
+{
+  /* fast convergence: a window that stopped short of the last w_max
+     means a new flow arrived, so give up some more */
+  w_max_ = cwnd_ < w_max_ ? cwnd_ * (1 + CUBIC_BETA) / 2 : cwnd_;
+  slow_start_.lost();
+
+  cwnd_ = ssthresh_ = max( cwnd_ * CUBIC_BETA, MIN_WINDOW );
+  epoch_start_ = 0;
+  timestamp_of_last_md_ = now;
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const uint64_t rtt = timestamp_ack_received - send_timestamp_acked;
+  rtt_estimator_.sample( rtt, timestamp_ack_received );
+
+  if ( slow_start_.active() ) {
+    /* the first slow start ends at HyStart's signals (or a loss) */
+    cwnd_ += slow_start_.acked( cwnd_, send_timestamp_acked, rtt,
+				rtt_estimator_.min_rtt(), timestamp_ack_received );
+    if ( not slow_start_.active() ) {
+      ssthresh_ = cwnd_;
+
+      if ( debug_ ) {
+	cerr << "At time " << timestamp_ack_received << " leaving slow start ("
+	     << slow_start_.exit_name() << ") at window " << cwnd_ << endl;
+      }
+    }
+  } else if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += 1; /* back up to ssthresh after a timeout */
+  } else {
+    cubic_update( timestamp_ack_received );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << "; window " << cwnd_ << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Back off once per window of data: only losses of datagrams sent
+     after the last decrease count */
+  if ( send_timestamp > timestamp_of_last_md_ ) {
+    multiplicative_decrease( timestamp_ms() );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  slow_start_.delivery_rate_sampled( sample );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* everything in flight is lost: back off, then slow start from the
+     minimum window up to the backed-off one */
+  if ( cwnd_ > MIN_WINDOW ) {
+    multiplicative_decrease( timestamp_ms() );
+  }
+  cwnd_ = MIN_WINDOW;
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip, faster in slow
+     start so pacing doesn't hold back the doubling (as Linux does) */
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  const double gain = cwnd_ < ssthresh_ ? SLOW_START_PACING_GAIN : PACING_GAIN;
+  return gain * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* paced acks arrive spread out, so an ack train must last longer */
+  slow_start_.set_paced( paced );
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "slow_start.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+  RttEstimator rtt_estimator_;
+
+  double cwnd_;
+  double ssthresh_;
+
+  /* the cubic epoch: growth since the last decrease follows
+     W(t) = C (t - K)^3 + w_max, which returns to w_max after K seconds */
+  uint64_t epoch_start_; /* 0 until the first ack after a decrease */
+  double w_max_;         /* the window before the last decrease */
+  double k_;
+  double w_est_;         /* what Reno would have (the TCP-friendly region) */
+  uint64_t timestamp_of_last_md_;
+
+  SlowStart slow_start_; /* the initial slow start, with HyStart's exits */
+
+  void cubic_update( const uint64_t now );
+  void multiplicative_decrease( const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
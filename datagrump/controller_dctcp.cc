@@ -0,0 +1,191 @@
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define ALPHA_GAIN (1.0 / 16) /* DCTCP's g */
+#define INITIAL_ALPHA 1.0 /* assume heavy marking until measured (as Linux does) */
+#define INITIAL_WINDOW 10.0
+#define MIN_WINDOW 2.0
+#define SLOW_START_PACING_GAIN 2.0
+#define PACING_GAIN 1.25
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    cwnd_( INITIAL_WINDOW ),
+    ssthresh_( numeric_limits<double>::infinity() ),
+    alpha_( INITIAL_ALPHA ),
+    timestamp_of_last_md_( 0 )
+{}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = (unsigned int) cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+
+  /* Reno's growth: slow start, then one datagram per RTT */
+  cwnd_ += cwnd_ < ssthresh_ ? 1 : 1 / cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << "; window " << cwnd_ << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* A loss still halves the window (once per window of data: only
+     losses of datagrams sent after the last decrease count) */
+  if ( send_timestamp > timestamp_of_last_md_ ) {
+    cwnd_ = ssthresh_ = max( cwnd_ / 2, MIN_WINDOW );
+    timestamp_of_last_md_ = timestamp_ms();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* DCTCP: back off in proportion to the extent of congestion, once
+     per window with any marks, so a few marks cost little and marks on
+     everything halve the window as a loss would */
+  alpha_ = (1 - ALPHA_GAIN) * alpha_ + ALPHA_GAIN * sample.ce_fraction;
+
+  if ( sample.ce_marked > 0 ) {
+    cwnd_ = ssthresh_ = max( cwnd_ * (1 - alpha_ / 2), MIN_WINDOW );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE; alpha " << alpha_
+	 << ", window " << cwnd_ << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* everything in flight is lost: slow start from the minimum window
+     up to half the old one */
+  ssthresh_ = max( cwnd_ / 2, MIN_WINDOW );
+  cwnd_ = MIN_WINDOW;
+  timestamp_of_last_md_ = timestamp_ms();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  const double gain = cwnd_ < ssthresh_ ? SLOW_START_PACING_GAIN : PACING_GAIN;
+  return gain * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
@@ -3,6 +3,12 @@
 
 #include <cstdint>
 
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "slow_start.hh"
+
 /* Congestion controller interface */
 
 class Controller
@@ -11,11 +17,13 @@ private:
   bool debug_; /* Enables debugging output */
 
   /* Add member variables here */
-  double rtt_;
+  Ewma rtt_;
+  RttEstimator rtt_estimator_; /* for the timeout */
 
   double cwnd_;
 
   uint64_t timestamp_of_last_md_;
+  SlowStart slow_start_; /* grows the window until the first congestion signal */
 
 public:
   /* Public interface for the congestion controller */
@@ -38,9 +46,37 @@ public:
 		     const uint64_t recv_timestamp_acked,
 		     const uint64_t timestamp_ack_received );
 
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
   /* How long to wait (in milliseconds) if there are no acks
      before sending one more datagram */
   unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+
+  /* Take over from another controller at the window it left */
+  void set_window( const double window );
 };
 
 #endif
@@ -0,0 +1,234 @@
+#include <iostream>
+#include <algorithm>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define START_CWND 10.0
+#define MIN_CWND 2.0
+#define AI_CONST 1.0 /* datagrams per round trip */
+#define HAI_ROUNDS 5 /* falling round trips before the increase turns hyperactive */
+#define HAI_FACTOR 5
+#define DECREASE_FACTOR 0.8 /* TIMELY's beta */
+#define GRADIENT_ALPHA 0.5
+#define VEGAS_ALPHA 2.0 /* datagrams queued: below this, always increase */
+#define VEGAS_BETA 6.0  /* datagrams queued: above this, drain the excess */
+#define PACING_GAIN 1.25
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    gradient_( GRADIENT_ALPHA ),
+    negative_gradient_rounds_( 0 ),
+    cwnd_( START_CWND ),
+    slow_start_( true ),
+    round_start_timestamp_( 0 ),
+    round_rtt_sum_( 0 ),
+    round_rtt_count_( 0 )
+{}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = (unsigned int) cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* Once per round trip, from the round's mean RTT: Vegas's count of
+   datagrams queued bounds the window; between the bounds, TIMELY's
+   normalized RTT gradient moves it */
+void Controller::end_round( const uint64_t now )
+{
+  const double min_rtt = rtt_estimator_.min_rtt();
+  const double rtt = round_rtt_sum_ / round_rtt_count_;
+
+  /* expected (cwnd/min RTT) minus actual (cwnd/RTT) throughput, in
+     datagrams per min RTT: how many of ours sit in the queue (both RTTs
+     floored at the clock's 1 ms, so a 0 ms path reads as no queue
+     rather than 0/0) */
+  const double queued = cwnd_ * (1 - max( 1.0, min_rtt ) / max( 1.0, rtt ));
+
+  gradient_.update( rtt );
+  const double gradient = gradient_.normalized( min_rtt );
+  negative_gradient_rounds_ = gradient <= 0 ? negative_gradient_rounds_ + 1 : 0;
+
+  if ( slow_start_ ) {
+    if ( queued > VEGAS_ALPHA ) {
+      slow_start_ = false;
+    }
+  } else if ( queued < VEGAS_ALPHA ) {
+    cwnd_ += AI_CONST;
+  } else if ( queued > VEGAS_BETA ) {
+    cwnd_ -= queued - VEGAS_BETA;
+  } else if ( gradient <= 0 ) {
+    cwnd_ += negative_gradient_rounds_ >= HAI_ROUNDS ? HAI_FACTOR * AI_CONST : AI_CONST;
+  } else {
+    cwnd_ *= 1 - DECREASE_FACTOR * min( gradient, 1.0 );
+  }
+  cwnd_ = max( cwnd_, MIN_CWND );
+
+  if ( debug_ ) {
+    cerr << "At time " << now
+	 << " round trip: mean RTT " << rtt << " ms, gradient " << gradient
+	 << ", queued " << queued << ", window " << cwnd_ << endl;
+  }
+
+  round_start_timestamp_ = now;
+  round_rtt_sum_ = 0;
+  round_rtt_count_ = 0;
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const uint64_t rtt = timestamp_ack_received - send_timestamp_acked;
+
+  rtt_estimator_.sample( rtt, timestamp_ack_received );
+  round_rtt_sum_ += rtt;
+  round_rtt_count_++;
+
+  if ( slow_start_ ) {
+    cwnd_ += 1; /* doubles every round trip */
+  }
+
+  if ( send_timestamp_acked >= round_start_timestamp_ ) {
+    end_round( timestamp_ack_received );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Default: take no action (the RTT trend reacts first) */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* nothing is known about the rate any more: start over */
+  cwnd_ = MIN_CWND;
+  slow_start_ = true;
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip */
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
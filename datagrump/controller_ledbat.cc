@@ -0,0 +1,254 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define TARGET 15.0 /* ms of queueing delay; below the delay-based controllers' */
+#define BASE_HISTORY 600000 /* ms the base delay is remembered (10 minutes) */
+#define CURRENT_FILTER 4 /* samples in the current delay's min filter */
+#define MAX_GAIN_DIVISOR 16 /* the least gain is 1/16 */
+#define DECREASE_CONSTANT 1.0
+#define SLOW_START_EXIT 0.75 /* of TARGET */
+#define SLOWDOWN_RTTS 2 /* how long a slowdown holds the minimum window */
+#define SLOWDOWN_INTERVAL 9 /* times a slowdown's duration until the next */
+#define INITIAL_WINDOW 2.0
+#define MIN_WINDOW 2.0
+#define PACING_GAIN 1.25
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    cwnd_( INITIAL_WINDOW ),
+    ssthresh_( numeric_limits<double>::infinity() ),
+    slow_start_( true ),
+    base_delay_( BASE_HISTORY ),
+    current_delay_( CURRENT_FILTER ),
+    delay_samples_( 0 ),
+    timestamp_of_last_md_( 0 ),
+    slowdown_start_( 0 ),
+    next_slowdown_( 0 )
+{}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = (unsigned int) cwnd_;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* LEDBAT++ scales the increase down on short paths, where a delay
+   target of a fixed size is many RTTs of queue: 1 / min(16, 2 target /
+   base RTT). The base RTT is on the sender's clock alone, unlike the
+   one-way delays. */
+double Controller::gain( void ) const
+{
+  const double base_rtt = max( uint64_t( 1 ), rtt_estimator_.min_rtt() );
+  return 1.0 / min( double( MAX_GAIN_DIVISOR ), ceil( 2 * TARGET / base_rtt ) );
+}
+
+/* Slow start is over; schedule the next slowdown, two RTTs after the
+   first slow start and then nine times as long as the last slowdown
+   took (so a slowdown costs about a tenth of the time) */
+void Controller::end_slow_start( const uint64_t now )
+{
+  slow_start_ = false;
+  ssthresh_ = cwnd_;
+
+  if ( slowdown_start_ ) {
+    next_slowdown_ = now + SLOWDOWN_INTERVAL * (now - slowdown_start_);
+    slowdown_start_ = 0;
+  } else if ( not next_slowdown_ ) {
+    next_slowdown_ = now + SLOWDOWN_RTTS * rtt_estimator_.srtt();
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const uint64_t now = timestamp_ack_received;
+  rtt_estimator_.sample( now - send_timestamp_acked, now );
+
+  /* (negative when the receiver's clock is behind) */
+  const double one_way_delay = double( int64_t( recv_timestamp_acked )
+				       - int64_t( send_timestamp_acked ) );
+  base_delay_.update( one_way_delay, now );
+  current_delay_.update( one_way_delay, delay_samples_++ );
+  const double queueing_delay = current_delay_.get() - base_delay_.get();
+
+  if ( next_slowdown_ and now >= next_slowdown_ and not slowdown_start_ and not slow_start_ ) {
+    /* slow start back up to the current window afterwards */
+    ssthresh_ = cwnd_;
+    cwnd_ = MIN_WINDOW;
+    slow_start_ = true;
+    slowdown_start_ = now;
+
+    if ( debug_ ) {
+      cerr << "At time " << now << " slowing down from window " << ssthresh_ << endl;
+    }
+  }
+
+  if ( slowdown_start_ and now - slowdown_start_ < SLOWDOWN_RTTS * rtt_estimator_.srtt() ) {
+    /* hold the minimum window */
+  } else if ( slow_start_ ) {
+    if ( queueing_delay > SLOW_START_EXIT * TARGET or cwnd_ >= ssthresh_ ) {
+      end_slow_start( now );
+    } else {
+      cwnd_ += gain();
+    }
+  } else {
+    /* grow by the gain per RTT below the target; above it, shrink in
+       proportion to the excess, by at most half the window per RTT */
+    const double change = queueing_delay <= TARGET
+      ? gain()
+      : max( gain() - DECREASE_CONSTANT * cwnd_ * (queueing_delay / TARGET - 1), -cwnd_ / 2 );
+    cwnd_ = max( cwnd_ + change / cwnd_, MIN_WINDOW );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << "; queueing delay " << queueing_delay << " ms, window " << cwnd_ << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Halve once per window of data: only losses of datagrams sent
+     after the last decrease count */
+  if ( send_timestamp > timestamp_of_last_md_ ) {
+    if ( slow_start_ and not slowdown_start_ ) {
+      end_slow_start( timestamp_ms() );
+    }
+    cwnd_ = max( cwnd_ / 2, MIN_WINDOW );
+    ssthresh_ = min( ssthresh_, cwnd_ );
+    timestamp_of_last_md_ = timestamp_ms();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* everything in flight is lost */
+  cwnd_ = MIN_WINDOW;
+  timestamp_of_last_md_ = timestamp_ms();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
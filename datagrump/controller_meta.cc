@@ -0,0 +1,399 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define META_EPOCH 500 /* ms between looks at the path */
+#define SWITCH_EPOCHS 3 /* a new regime must hold this many epochs in a row */
+#define MIN_DWELL 4000 /* ms a child keeps control at least */
+#define LOSS_EWMA 0.5
+#define RATE_CHANGE_EWMA 0.5
+#define JITTERY 0.25 /* RTTVAR over SRTT */
+#define VOLATILE 0.3 /* the delivery rate's coefficient of variation */
+#define LOSSY 0.02 /* fraction of datagrams lost */
+#define BLOATED 2.0 /* SRTT over the minimum RTT */
+#define PACING_GAIN 1.25
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+static const char * const CHILD_NAMES[] = { "fixed window", "AIMD", "delay", "custom", "Sarsa" };
+static const char * const REGIME_NAMES[] = { "stable", "volatile", "jittery", "lossy", "bloated" };
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    fixed_window_( false ),
+    aimd_( false ),
+    delay_( false ),
+    custom_( false ),
+    sarsa_( false ),
+    active_( CustomChild ),
+    previous_( CustomChild ),
+    switch_timestamp_( timestamp_ms() ),
+    handover_window_( 0 ),
+    epoch_start_( timestamp_ms() ),
+    acked_( 0 ),
+    lost_( 0 ),
+    rate_sum_( 0 ),
+    rate_sum_of_squares_( 0 ),
+    rate_samples_( 0 ),
+    loss_rate_( LOSS_EWMA ),
+    last_epoch_rate_( 0 ),
+    rate_change_( RATE_CHANGE_EWMA ),
+    regime_( Volatile ),
+    candidate_( Volatile ),
+    candidate_epochs_( 0 )
+{}
+
+double Controller::child_window( const Child child )
+{
+  switch ( child ) {
+  case FixedWindowChild: return fixed_window_.window_size();
+  case AimdChild: return aimd_.window_size();
+  case DelayChild: return delay_.window_size();
+  case CustomChild: return custom_.window_size();
+  case SarsaChild: return sarsa_.window_size();
+  }
+  return 1;
+}
+
+/* Hand a child the window in force, so that it takes over from there
+   rather than from the window it shadowed while another child drove */
+void Controller::seed_child_window( const Child child, const double window )
+{
+  switch ( child ) {
+  case FixedWindowChild: fixed_window_.set_window( window ); return;
+  case AimdChild: aimd_.set_window( window ); return;
+  case DelayChild: delay_.set_window( window ); return;
+  case CustomChild: custom_.set_window( window ); return;
+  case SarsaChild: sarsa_.set_window( window ); return;
+  }
+}
+
+/* The active child's window, reached gradually over one smoothed RTT
+   after a switch, starting from the window at the time of the switch
+   (a child seeded with that window starts there anyway; the fixed
+   window, which can't be seeded, moves to its own) */
+double Controller::window( void )
+{
+  const double target = child_window( active_ );
+  if ( previous_ == active_ ) {
+    return target;
+  }
+
+  const double progress = (timestamp_ms() - switch_timestamp_)
+    / max( 1.0, rtt_estimator_.srtt() );
+  if ( progress >= 1 ) {
+    previous_ = active_;
+    return target;
+  }
+
+  return handover_window_ + (target - handover_window_) * progress;
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = max( 1u, (unsigned int) window() );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size
+	 << " (" << CHILD_NAMES[ active_ ] << ")" << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  fixed_window_.datagram_was_sent( sequence_number, send_timestamp );
+  aimd_.datagram_was_sent( sequence_number, send_timestamp );
+  delay_.datagram_was_sent( sequence_number, send_timestamp );
+  custom_.datagram_was_sent( sequence_number, send_timestamp );
+  sarsa_.datagram_was_sent( sequence_number, send_timestamp );
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* Which regime the path is in. Losses with no standing queue behind
+   them aren't congestion (a loss-agnostic fixed window rides them
+   out); a standing queue needs draining; a delivery rate that swings
+   is a cellular-style link (what the custom controller was tuned
+   for); RTTs that swing with a steady rate are jitter, which the delay
+   controller's smoothed RTT rides out; otherwise AIMD probes a stable
+   path. */
+Controller::Regime Controller::classify( const double jitter, const double loss_rate,
+					 const double rate_variation,
+					 const double standing_ratio ) const
+{
+  if ( standing_ratio > BLOATED ) {
+    return Bloated;
+  } else if ( loss_rate > LOSSY ) {
+    return Lossy;
+  } else if ( rate_variation > VOLATILE ) {
+    return Volatile;
+  } else if ( jitter > JITTERY ) {
+    return Jittery;
+  }
+  return Stable;
+}
+
+/* Look at the path over the epoch just ended, and hand control to
+   another child once a new regime has held for SWITCH_EPOCHS epochs
+   (and the current child has had MIN_DWELL) */
+void Controller::end_epoch( const uint64_t now )
+{
+  loss_rate_.update( acked_ + lost_ ? double( lost_ ) / (acked_ + lost_) : 0 );
+
+  /* the delivery rate's variation within the epoch, or from the last
+     epoch to this one, whichever is larger (a cellular link's rate
+     mostly swings over seconds, not milliseconds) */
+  double rate_variation = 0;
+  if ( rate_samples_ >= 2 and rate_sum_ > 0 ) {
+    const double mean = rate_sum_ / rate_samples_;
+    const double variance = rate_sum_of_squares_ / rate_samples_ - mean * mean;
+    rate_variation = sqrt( max( 0.0, variance ) ) / mean;
+
+    if ( last_epoch_rate_ > 0 ) {
+      rate_change_.update( fabs( mean - last_epoch_rate_ ) / max( mean, last_epoch_rate_ ) );
+    }
+    last_epoch_rate_ = mean;
+  }
+  rate_variation = max( rate_variation, rate_change_.get() );
+
+  const double srtt = rtt_estimator_.srtt();
+  const double jitter = srtt > 0 ? rtt_estimator_.rttvar() / srtt : 0;
+  const double standing_ratio = srtt > 0 and rtt_estimator_.min_rtt() > 0
+    ? srtt / rtt_estimator_.min_rtt() : 1;
+
+  const Regime regime = classify( jitter, loss_rate_.get(), rate_variation, standing_ratio );
+
+  if ( regime == regime_ ) {
+    candidate_epochs_ = 0;
+  } else if ( regime == candidate_ and candidate_epochs_ > 0 ) {
+    candidate_epochs_++;
+  } else {
+    candidate_ = regime;
+    candidate_epochs_ = 1;
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << now << " meta: " << REGIME_NAMES[ regime ]
+	 << " (jitter " << jitter << ", loss " << loss_rate_.get()
+	 << ", rate variation " << rate_variation
+	 << ", SRTT/min " << standing_ratio << ")" << endl;
+  }
+
+  if ( candidate_epochs_ >= SWITCH_EPOCHS and now - switch_timestamp_ >= MIN_DWELL ) {
+    regime_ = candidate_;
+    candidate_epochs_ = 0;
+
+    static const Child BEST_CHILD[] = { AimdChild, CustomChild, DelayChild,
+					FixedWindowChild, SarsaChild };
+    const Child child = BEST_CHILD[ regime_ ];
+
+    /* always logged, so a run shows which controller ran when */
+    cerr << "At time " << now << " meta: path is " << REGIME_NAMES[ regime_ ]
+	 << " (jitter " << jitter << ", loss " << loss_rate_.get()
+	 << ", rate variation " << rate_variation
+	 << ", SRTT/min " << standing_ratio << "); ";
+    if ( child == active_ ) {
+      cerr << "staying with " << CHILD_NAMES[ active_ ] << endl;
+    } else {
+      cerr << "switching from " << CHILD_NAMES[ active_ ]
+	   << " to " << CHILD_NAMES[ child ] << endl;
+      handover_window_ = window();
+      seed_child_window( child, handover_window_ );
+      previous_ = active_;
+      active_ = child;
+      switch_timestamp_ = now;
+    }
+  }
+
+  epoch_start_ = now;
+  acked_ = lost_ = 0;
+  rate_sum_ = rate_sum_of_squares_ = 0;
+  rate_samples_ = 0;
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+  acked_++;
+
+  fixed_window_.ack_received( sequence_number_acked, send_timestamp_acked,
+			      recv_timestamp_acked, timestamp_ack_received );
+  aimd_.ack_received( sequence_number_acked, send_timestamp_acked,
+		      recv_timestamp_acked, timestamp_ack_received );
+  delay_.ack_received( sequence_number_acked, send_timestamp_acked,
+		       recv_timestamp_acked, timestamp_ack_received );
+  custom_.ack_received( sequence_number_acked, send_timestamp_acked,
+			recv_timestamp_acked, timestamp_ack_received );
+  sarsa_.ack_received( sequence_number_acked, send_timestamp_acked,
+		       recv_timestamp_acked, timestamp_ack_received );
+
+  if ( timestamp_ack_received - epoch_start_ >= META_EPOCH ) {
+    end_epoch( timestamp_ack_received );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  fixed_window_.flight_updated( datagrams_in_flight, bytes_in_flight, delivered );
+  aimd_.flight_updated( datagrams_in_flight, bytes_in_flight, delivered );
+  delay_.flight_updated( datagrams_in_flight, bytes_in_flight, delivered );
+  custom_.flight_updated( datagrams_in_flight, bytes_in_flight, delivered );
+  sarsa_.flight_updated( datagrams_in_flight, bytes_in_flight, delivered );
+
+  /* (the custom controller's own sender does this on every poll) */
+  custom_.purge_outstanding_packets();
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  lost_++;
+
+  fixed_window_.packet_lost( sequence_number, send_timestamp );
+  aimd_.packet_lost( sequence_number, send_timestamp );
+  delay_.packet_lost( sequence_number, send_timestamp );
+  custom_.packet_lost( sequence_number, send_timestamp );
+  sarsa_.packet_lost( sequence_number, send_timestamp );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  rate_sum_ += sample.delivery_rate;
+  rate_sum_of_squares_ += sample.delivery_rate * sample.delivery_rate;
+  rate_samples_++;
+
+  fixed_window_.delivery_rate_sampled( sample );
+  aimd_.delivery_rate_sampled( sample );
+  delay_.delivery_rate_sampled( sample );
+  custom_.delivery_rate_sampled( sample );
+  sarsa_.delivery_rate_sampled( sample );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  fixed_window_.ecn_sampled( sample );
+  aimd_.ecn_sampled( sample );
+  delay_.ecn_sampled( sample );
+  custom_.ecn_sampled( sample );
+  sarsa_.ecn_sampled( sample );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  fixed_window_.timeout_expired();
+  aimd_.timeout_expired();
+  delay_.timeout_expired();
+  custom_.timeout_expired();
+  sarsa_.timeout_expired();
+
+  /* (as the AIMD and custom controllers' own senders do) */
+  aimd_.multiplicative_decrease();
+  custom_.multiplicative_decrease();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * window() * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  fixed_window_.set_paced( paced );
+  aimd_.set_paced( paced );
+  delay_.set_paced( paced );
+  custom_.set_paced( paced );
+  sarsa_.set_paced( paced );
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
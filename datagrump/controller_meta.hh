@@ -0,0 +1,108 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "meta_children.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+  RttEstimator rtt_estimator_;
+
+  /* the hosted controllers, all fed every event side by side */
+  FixedWindowController fixed_window_;
+  AimdController aimd_;
+  DelayController delay_;
+  CustomController custom_;
+  SarsaController sarsa_;
+
+  enum Child { FixedWindowChild, AimdChild, DelayChild, CustomChild, SarsaChild };
+  enum Regime { Stable, Volatile, Jittery, Lossy, Bloated };
+
+  Child active_;
+  Child previous_;            /* handing over to active_ until one RTT after */
+  uint64_t switch_timestamp_;
+  double handover_window_;    /* the window when the switch happened */
+
+  /* the path over the current epoch */
+  uint64_t epoch_start_;
+  uint64_t acked_, lost_;
+  double rate_sum_, rate_sum_of_squares_;
+  uint64_t rate_samples_;
+  Ewma loss_rate_;
+  double last_epoch_rate_;    /* the mean delivery rate over the last epoch */
+  Ewma rate_change_;          /* relative change in it from epoch to epoch */
+
+  Regime regime_;             /* the regime now in force */
+  Regime candidate_;          /* a different regime seen lately */
+  unsigned int candidate_epochs_;
+
+  double child_window( const Child child );
+  void seed_child_window( const Child child, const double window );
+  double window( void );
+  Regime classify( const double jitter, const double loss_rate,
+		   const double rate_variation, const double standing_ratio ) const;
+  void end_epoch( const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
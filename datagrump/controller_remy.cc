@@ -0,0 +1,215 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define RULES_VARIABLE "REMY_RULES" /* names a rule table file to load */
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Used when $REMY_RULES is unset: grow while the RTT is near its
+   minimum, hold as a queue appears, and shrink per ack beyond that */
+static const char DEFAULT_RULES[] =
+  "# ack_ewma     send_ewma    rtt_ratio   slow_ewma    mult  incr intersend\n"
+  "  0 1e9        0 1e9        0   1.2     0 1e9        1.00  1.0  0\n"
+  "  0 1e9        0 1e9        1.2 1.5     0 1e9        1.00  0.1  0\n"
+  "  0 1e9        0 1e9        1.5 2       0 1e9        0.99  0    0\n"
+  "  0 1e9        0 1e9        2   1e9     0 1e9        0.97  0    0\n";
+
+/* The rule table named by $REMY_RULES, or the default */
+static string load_rules( void )
+{
+  const char * path = getenv( RULES_VARIABLE );
+  if ( not path ) {
+    return DEFAULT_RULES;
+  }
+
+  ifstream file( path );
+  if ( not file ) {
+    throw runtime_error( string( "cannot read whisker table " ) + path );
+  }
+
+  stringstream rules;
+  rules << file.rdbuf();
+  return rules.str();
+}
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    whiskers_( load_rules() ),
+    memory_(),
+    cwnd_( 0 ),
+    intersend_( 0 )
+{
+  /* as at the start of a Remy flow: the window is what the whisker for
+     an empty memory makes of 0 */
+  apply( whiskers_.lookup( memory_.state() ) );
+
+  if ( debug_ ) {
+    cerr << "Compiled " << whiskers_.size() << " whiskers into "
+	 << whiskers_.nodes() << " nodes" << endl;
+  }
+}
+
+/* Take a whisker's action */
+void Controller::apply( const WhiskerAction & action )
+{
+  cwnd_ = action.window( cwnd_ );
+  intersend_ = action.intersend;
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  /* (never 0, which would leave nothing in flight to ack) */
+  unsigned int the_window_size = max( 1.0, cwnd_ );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+
+  memory_.acked( send_timestamp_acked, timestamp_ack_received );
+  apply( whiskers_.lookup( memory_.state() ) );
+
+  if ( debug_ ) {
+    const WhiskerMemory::State state = memory_.state();
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << "; memory " << state[ 0 ] << " " << state[ 1 ] << " " << state[ 2 ]
+	 << " " << state[ 3 ] << ", window " << cwnd_ << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Default: take no action (Remy's signals are all delay-based) */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* nothing the memory says is current any more: start the flow over */
+  memory_.reset();
+  cwnd_ = 0;
+  apply( whiskers_.lookup( memory_.state() ) );
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  return intersend_ > 0 ? 1000.0 / intersend_ : 0;
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "controller.hh"
 #include "timestamp.hh"
@@ -7,7 +9,11 @@
 #define THROUGHPUT_EWMA 0.7
 #define RTT_EWMA 0.1
 #define SCORE_EWMA 0.4
-#define TIMEOUT 100
+#define TIMEOUT 100 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+#define PACING_GAIN 1.25
 
 #define VERY_LOW 0
 #define LOW 1
@@ -16,10 +22,36 @@
 #define VERY_HIGH 4
 
 #define NUM_ACTIONS 9
+#define TILINGS 8
+#define TILES 16 /* per feature */
+#define MAX_THROUGHPUT 20 /* datagrams per 10 ms */
+#define MAX_DELAY 400 /* ms */
+#define ALPHA 0.1 /* per step; the traces spread each update over past steps */
+#define EPSILON 0.05
+#define GAMMA 0.9
+#define LAMBDA 0.8
+#define TABLE_VARIABLE "SARSA_TABLE" /* names a table file to start from and save to */
+#define FROZEN_VARIABLE "SARSA_FROZEN" /* set (and not 0) to run the table as it is */
+#define SAVE_INTERVAL 2000 /* ms between saves of the table */
+
+/* The learner's state: one-way delay and throughput, tile coded */
+static TileCoder state_coder( void ) {
+  return TileCoder({ { 0, MAX_DELAY }, { 0, MAX_THROUGHPUT } }, TILINGS, TILES);
+}
 
 using namespace std;
 
-int discretize_throughput(double throughput) {
+static string table_path( void ) {
+  const char * path = getenv(TABLE_VARIABLE);
+  return path ? path : "";
+}
+
+static bool frozen_requested( void ) {
+  const char * value = getenv(FROZEN_VARIABLE);
+  return value && *value && strcmp(value, "0");
+}
+
+static int discretize_throughput(double throughput) {
   if (throughput < 3) {
     return LOW;
   } else if (throughput < 5) {
@@ -29,7 +61,7 @@ int discretize_throughput(double throughput) {
   }
 }
 
-int discretize_delay(double delay) {
+static int discretize_delay(double delay) {
   if (delay < 100) {
     return LOW;
   } else if (delay < 200) {
@@ -39,28 +71,6 @@ int discretize_delay(double delay) {
   }
 }
 
-int state_for_discretized_pair(int tp, int delay) {
-  if (tp == LOW && delay == LOW) {
-    return 0;
-  } else if (tp == LOW && delay == MED) {
-    return 1;
-  } else if (tp == LOW && delay == HIGH) {
-    return 2;
-  } else if (tp == MED && delay == LOW) {
-    return 3;
-  } else if (tp == MED && delay == MED) {
-    return 4;
-  } else if (tp == MED && delay == HIGH) {
-    return 5;
-  } else if (tp == HIGH && delay == LOW) {
-    return 6;
-  } else if (tp == HIGH && delay == MED) {
-    return 7;
-  } else {
-    return 8;
-  }
-}
-
 double Controller::compute_score(double throughput, double delay) {
   int d_throughput = discretize_throughput(throughput);
   int d_delay = discretize_delay(delay);
@@ -98,29 +108,47 @@ void Controller::act(int action) {
 /* Default constructor */
 Controller::Controller( const bool debug ) : 
   debug_(debug),
-  rtt_(),
-  throughput_(),
-  score_(),
+  rtt_(RTT_EWMA),
+  rtt_estimator_(TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW),
+  throughput_(THROUGHPUT_EWMA),
+  delivery_rate_(0),
+  score_(SCORE_EWMA),
   num_packets_in_epoch_(0),
   start_of_last_epoch_(timestamp_ms()),
-  last_state_(-1),
   last_action_(-1),
   cwnd_(1),
-  q_(9, NUM_ACTIONS, 0.4, 0.05, 0.9, true)
+  q_(state_coder(), NUM_ACTIONS, ALPHA, EPSILON, GAMMA, LAMBDA, time(NULL)),
+  table_path_(table_path()),
+  frozen_(frozen_requested()),
+  saver_(),
+  last_save_(timestamp_ms())
 {
-  rtt_.set_alpha(RTT_EWMA);
-  throughput_.set_alpha(THROUGHPUT_EWMA);
-  score_.set_alpha(SCORE_EWMA);
+  if (!frozen_ && !table_path_.empty()) {
+    saver_.reset(new TableSaver(q_, table_path_));
+  }
+
+  if (frozen_) {
+    // Run the table greedily.
+    q_.set_epsilon(0);
+  }
+
+  // Warm start from a saved table, if there is one.
+  if (!table_path_.empty() && q_.load(table_path_)) {
+    cerr << "Loaded Q table " << table_path_ << (frozen_ ? " (frozen)" : "") << endl;
+    return;
+  }
+
+  // Priors: the action to start with at each (throughput, delay) level,
+  // set across the whole level at half-tile spacing.
+  const int preferred[3][3] = { { 7, 4, 2 }, { 6, 4, 1 }, { 3, 2, NUM_ACTIONS - 1 } };
   double greedy_value = 900;
-  q_.prefer_action(state_for_discretized_pair(LOW, LOW), 7, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(LOW, MED), 4, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(LOW, HIGH), 2, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(MED, LOW), 6, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(MED, MED), 4, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(MED, HIGH), 1, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(HIGH, LOW), 3, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(HIGH, MED), 2, greedy_value);
-  q_.prefer_action(state_for_discretized_pair(HIGH, HIGH), 9, greedy_value);
+  for (double delay = 0; delay < MAX_DELAY; delay += MAX_DELAY / TILES / 2.0) {
+    for (double tp = 0; tp < MAX_THROUGHPUT; tp += MAX_THROUGHPUT / TILES / 2.0) {
+      q_.prefer_action({ delay, tp },
+                       preferred[discretize_throughput(tp) - LOW][discretize_delay(delay) - LOW],
+                       greedy_value);
+    }
+  }
 }
 
 /* Get current window size, in datagrams */
@@ -164,6 +192,8 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
                                /* when the ack was received (by sender) */
 {
   // Update RTT estimate.
+  rtt_estimator_.sample(timestamp_ack_received - send_timestamp_acked,
+                        timestamp_ack_received);
   rtt_.update(timestamp_ack_received - send_timestamp_acked);
 
   // Indicate that another packet arrived during this epoch.
@@ -175,9 +205,15 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
   // If the epoch is over...
   if (now - start_of_last_epoch_ >= EPOCH) {
 
-    // Update the throughput estimate.
+    // Update the throughput estimate (in datagrams per 10 ms), from the
+    // delivery rate if the sender has measured one, else from the acks
+    // counted this epoch.
     double to_packets_per_second = 10.0;
-    throughput_.update(to_packets_per_second * ((double)num_packets_in_epoch_) / ((double)EPOCH));
+    if (delivery_rate_ > 0) {
+      throughput_.update(delivery_rate_ / 100.0);
+    } else {
+      throughput_.update(to_packets_per_second * ((double)num_packets_in_epoch_) / ((double)EPOCH));
+    }
     //cerr << "delay: " << rtt_.get() / 2 << " and throughput " << throughput_.get() << endl;
 
     // Update the start of the epoch and indicate that no packets arrived during this epoch.
@@ -187,21 +223,22 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
     // Since the epoch is over, pick a new action for the next state.
     double score = compute_score(throughput_.get(), rtt_.get() / 2);
     //cerr << "score: " << score << endl;
-    int state = state_for_discretized_pair(
-      discretize_delay(rtt_.get() / 2),
-      discretize_throughput(throughput_.get())
-    );
-    if (last_action_ >= 0 && last_state_ >= 0) {
-      q_.update_with_reward(last_state_, last_action_, state, score);
-    }
-    int action = q_.act_eps_greedily(state);
+    int action = q_.step(score, { rtt_.get() / 2, throughput_.get() });
     act(action);
-    cerr << "tp " << throughput_.get() << " and delay " << rtt_.get() / 2 << endl;
-    cerr << last_state_ << " => " << state << " "
-      << last_action_ << " => " << action << " "
-      << "rew=" << score << " and cwnd=" << cwnd_ << endl;
-    last_state_ = state;
+    if ( debug_ ) {
+      cerr << "tp " << throughput_.get() << " and delay " << rtt_.get() / 2 << endl;
+      cerr << last_action_ << " => " << action << " "
+        << "rew=" << score << " (Q " << q_.q() << ") and cwnd=" << cwnd_ << endl;
+    }
     last_action_ = action;
+
+    // Keep the saved table up to date (the sender is usually killed, so
+    // there is no saving at exit). This only copies the weights; the
+    // saver's thread does the writing.
+    if (saver_ && now - last_save_ >= SAVE_INTERVAL) {
+      saver_->save();
+      last_save_ = now;
+    }
   }
 
   if ( debug_ ) {
@@ -213,9 +250,104 @@ void Controller::ack_received( const uint64_t sequence_number_acked,
   }
 }
 
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Default: take no action (losses show up in the reward as delay) */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* the latest rate stands in for counting acks over the epoch */
+  delivery_rate_ = sample.delivery_rate;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
 /* How long to wait (in milliseconds) if there are no acks
    before sending one more datagram */
 unsigned int Controller::timeout_ms( void )
 {
-  return TIMEOUT; /* timeout of one second */
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip */
+  if ( rtt_.get() <= 0 ) {
+    return 0;
+  }
+
+  return PACING_GAIN * cwnd_ * 1000.0 / rtt_.get();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
+
+/* Take over from another controller at the window it left */
+void Controller::set_window( const double window )
+{
+  cwnd_ = max( 1.0, window );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms() << " taking over at window " << window << endl;
+  }
 }
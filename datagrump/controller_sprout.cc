@@ -0,0 +1,359 @@
+#include <iostream>
+#include <cmath>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define TICK 20 /* ms between belief updates */
+#define NUM_BINS 256
+#define MAX_RATE 1000.0 /* datagrams per second (about 12 Mbit/s) */
+#define VOLATILITY 200.0 /* Brownian motion of the rate, datagrams/s per sqrt(second) */
+#define MIN_PROBABILITY 1e-6 /* no rate is ever ruled out entirely */
+#define DELAY_TARGET 100 /* ms a datagram may wait at the bottleneck */
+#define PERCENTILE 0.05
+#define QUEUE_EVIDENCE 5 /* ms of queueing that shows the link had a backlog */
+#define START_WINDOW 10
+#define PACING_GAIN 1.25
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    belief_( NUM_BINS, 1.0 / NUM_BINS ),
+    rates_( NUM_BINS ),
+    kernel_(),
+    forecast_belief_( NUM_BINS ),
+    scratch_( NUM_BINS ),
+    pmf_( NUM_BINS ),
+    cdf_( NUM_BINS ),
+    tick_start_( 0 ),
+    acks_this_tick_( 0 ),
+    max_queueing_this_tick_( 0 ),
+    last_tick_busy_( false ),
+    in_flight_at_tick_start_( 0 ),
+    datagrams_in_flight_( 0 ),
+    forecast_( -1 ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW )
+{
+  const double bin_width = MAX_RATE / (NUM_BINS - 1);
+  for ( size_t i = 0; i < NUM_BINS; i++ ) {
+    rates_[ i ] = i * bin_width * TICK / 1000.0;
+  }
+
+  /* over one tick the rate takes a Gaussian step, in units of bins */
+  const double sigma = VOLATILITY * sqrt( TICK / 1000.0 ) / bin_width;
+  const int radius = ceil( 3 * sigma );
+  double total = 0;
+  for ( int offset = -radius; offset <= radius; offset++ ) {
+    kernel_.push_back( exp( -0.5 * offset * offset / (sigma * sigma) ) );
+    total += kernel_.back();
+  }
+  for ( double & weight : kernel_ ) {
+    weight /= total;
+  }
+}
+
+/* Let the rate wander for one tick: blur the belief with the
+   Brownian-motion kernel (mass pushed past either end stays there) */
+void Controller::evolve( vector<double> & belief )
+{
+  const int radius = kernel_.size() / 2;
+
+  fill( scratch_.begin(), scratch_.end(), 0.0 );
+  for ( int i = 0; i < NUM_BINS; i++ ) {
+    for ( int offset = -radius; offset <= radius; offset++ ) {
+      const int j = min( max( i + offset, 0 ), NUM_BINS - 1 );
+      scratch_[ j ] += belief[ i ] * kernel_[ offset + radius ];
+    }
+  }
+
+  double total = 0;
+  for ( int i = 0; i < NUM_BINS; i++ ) {
+    belief[ i ] = scratch_[ i ] + MIN_PROBABILITY;
+    total += belief[ i ];
+  }
+  for ( double & p : belief ) {
+    p /= total;
+  }
+}
+
+/* Bayes' rule with a Poisson likelihood of the deliveries seen in one
+   tick. If the link may have run out of datagrams, the count is only
+   a lower bound on what it could have delivered. */
+void Controller::observe( const uint64_t delivered, const bool link_was_busy )
+{
+  double total = 0;
+
+  for ( int i = 0; i < NUM_BINS; i++ ) {
+    const double mu = rates_[ i ];
+    double likelihood;
+
+    if ( link_was_busy ) {
+      likelihood = mu > 0
+	? exp( delivered * log( mu ) - mu - lgamma( delivered + 1.0 ) )
+	: ( delivered == 0 ? 1 : 0 );
+    } else {
+      /* P(at least this many) = 1 - P(fewer) */
+      double pmf = exp( -mu ), fewer = 0;
+      for ( uint64_t k = 0; k < delivered; k++ ) {
+	fewer += pmf;
+	pmf *= mu / (k + 1);
+      }
+      likelihood = max( 0.0, 1 - fewer );
+    }
+
+    belief_[ i ] *= likelihood;
+    total += belief_[ i ];
+  }
+
+  /* an observation the model thought impossible: start over */
+  if ( total <= 0 ) {
+    fill( belief_.begin(), belief_.end(), 1.0 / NUM_BINS );
+    return;
+  }
+
+  for ( double & p : belief_ ) {
+    p /= total;
+  }
+}
+
+/* The cautious forecast: the number of deliveries, over the time a
+   datagram sent now may take to be acked, that the link exceeds with
+   95% probability */
+void Controller::update_forecast( void )
+{
+  const double min_rtt = rtt_estimator_.has_sample() ? rtt_estimator_.min_rtt() : 0;
+  const double horizon_ticks = (min_rtt + DELAY_TARGET) / TICK;
+
+  /* the rate keeps wandering over the horizon: forecast from the
+     belief as it will be halfway through */
+  forecast_belief_ = belief_;
+  for ( int tick = 0; tick < horizon_ticks / 2; tick++ ) {
+    evolve( forecast_belief_ );
+  }
+
+  /* cumulative deliveries are Poisson in each bin; walk the mixture's
+     CDF up to the percentile, one count at a time, across all bins */
+  for ( int i = 0; i < NUM_BINS; i++ ) {
+    const double mu = rates_[ i ] * horizon_ticks;
+    scratch_[ i ] = mu;
+    pmf_[ i ] = exp( -mu );
+    cdf_[ i ] = pmf_[ i ];
+  }
+
+  const uint64_t max_count = rates_.back() * horizon_ticks * 2 + 10;
+  uint64_t count = 0;
+  while ( count < max_count ) {
+    /* four partial sums, so the loop vectorizes without reassociation */
+    double partial[ 4 ] = { 0, 0, 0, 0 };
+    for ( int i = 0; i < NUM_BINS; i += 4 ) {
+      for ( int lane = 0; lane < 4; lane++ ) {
+	partial[ lane ] += forecast_belief_[ i + lane ] * cdf_[ i + lane ];
+      }
+    }
+    if ( partial[ 0 ] + partial[ 1 ] + partial[ 2 ] + partial[ 3 ] >= PERCENTILE ) {
+      break;
+    }
+
+    count++;
+    for ( int i = 0; i < NUM_BINS; i++ ) {
+      pmf_[ i ] *= scratch_[ i ] / count;
+      cdf_[ i ] += pmf_[ i ];
+    }
+  }
+
+  forecast_ = count;
+}
+
+/* Run a belief update for each tick that has ended */
+void Controller::advance_ticks( const uint64_t now )
+{
+  if ( tick_start_ == 0 ) {
+    return; /* ticks start with the first ack */
+  }
+
+  bool ticked = false;
+  while ( now >= tick_start_ + TICK ) {
+    /* The count measures the link only if the link had a backlog: some
+       ack showed queueing delay, or the acks stopped while datagrams
+       were waiting (an outage) */
+    const bool busy = max_queueing_this_tick_ >= QUEUE_EVIDENCE
+      or ( acks_this_tick_ == 0 and last_tick_busy_ and in_flight_at_tick_start_ > 0 );
+
+    evolve( belief_ );
+    observe( acks_this_tick_, busy );
+
+    last_tick_busy_ = busy;
+    acks_this_tick_ = 0;
+    max_queueing_this_tick_ = 0;
+    in_flight_at_tick_start_ = datagrams_in_flight_;
+    tick_start_ += TICK;
+    ticked = true;
+  }
+
+  if ( ticked ) {
+    update_forecast();
+  }
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  advance_ticks( timestamp_ms() );
+
+  unsigned int the_window_size = forecast_ < 0 ? START_WINDOW
+    : max( 1u, (unsigned int) forecast_ );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  rtt_estimator_.sample( timestamp_ack_received - send_timestamp_acked,
+			 timestamp_ack_received );
+
+  /* acks come back at the rate the link delivered the datagrams, so
+     counting them per tick observes the link */
+  if ( tick_start_ == 0 ) {
+    tick_start_ = timestamp_ack_received;
+    in_flight_at_tick_start_ = datagrams_in_flight_;
+  }
+  advance_ticks( timestamp_ack_received );
+  acks_this_tick_++;
+
+  const uint64_t rtt = timestamp_ack_received - send_timestamp_acked;
+  max_queueing_this_tick_ = max( max_queueing_this_tick_,
+				 rtt - min( rtt, rtt_estimator_.min_rtt() ) );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  datagrams_in_flight_ = datagrams_in_flight;
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  /* Default: take no action (the forecast already reflects deliveries) */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  /* Spread the window over one smoothed round trip */
+  if ( rtt_estimator_.srtt() <= 0 ) {
+    return 0;
+  }
+
+  const double window = forecast_ < 0 ? START_WINDOW : max( 1.0, forecast_ );
+  return PACING_GAIN * window * 1000.0 / rtt_estimator_.srtt();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
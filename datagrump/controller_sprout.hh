@@ -0,0 +1,99 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+
+  /* belief about the link rate: probability of each rate bin */
+  std::vector<double> belief_;
+  std::vector<double> rates_;  /* rate of each bin, datagrams per tick */
+  std::vector<double> kernel_; /* Brownian-motion step over one tick */
+
+  /* scratch space, reused every tick */
+  std::vector<double> forecast_belief_;
+  std::vector<double> scratch_;
+  std::vector<double> pmf_;
+  std::vector<double> cdf_;
+
+  uint64_t tick_start_;       /* when the current tick began (0 before the first ack) */
+  uint64_t acks_this_tick_;
+  uint64_t max_queueing_this_tick_; /* most queueing delay an ack showed (ms) */
+  bool last_tick_busy_;
+  uint64_t in_flight_at_tick_start_;
+  uint64_t datagrams_in_flight_;
+
+  double forecast_; /* cautious deliveries over the window's horizon */
+
+  RttEstimator rtt_estimator_;
+
+  void evolve( std::vector<double> & belief );
+  void observe( const uint64_t delivered, const bool link_was_busy );
+  void update_forecast( void );
+  void advance_ticks( const uint64_t now );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
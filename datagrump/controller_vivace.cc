@@ -0,0 +1,416 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+
+#include "controller.hh"
+#include "timestamp.hh"
+
+#define DATAGRAM_BITS (1472 * 8) /* the sender's DATAGRAM_SIZE */
+#define START_RATE 100.0 /* datagrams per second */
+#define MIN_RATE 20.0
+#define START_WINDOW 10
+#define MIN_CWND 2.0
+#define WINDOW_GAIN 2.0 /* the window only caps the rate: two BDPs at it */
+#define INITIAL_INTERVAL 100 /* ms, until the first RTT sample */
+#define INTERVAL_RTTS 2.0
+#define MIN_INTERVAL_DATAGRAMS 10
+#define EPSILON 0.05 /* probe rates are rate * (1 +/- EPSILON) */
+#define PROBE_PAIRS 2
+/* Vivace-Latency's utility: x^EXPONENT - LATENCY_COEFFICIENT * x * dRTT/dT
+   - LOSS_COEFFICIENT * x * loss, with the sending rate x in Mbit/s */
+#define EXPONENT 0.9
+#define LATENCY_COEFFICIENT 900.0
+#define LOSS_COEFFICIENT 11.35
+#define GRADIENT_TOLERANCE 0.01 /* smaller RTT gradients are noise */
+#define STEP_SIZE 1.0 /* Mbit/s of rate change per unit of utility gradient */
+#define INITIAL_BOUNDARY 0.05 /* largest step, as a fraction of the rate */
+#define BOUNDARY_GROWTH 0.1
+#define TIMEOUT 1000 /* until the first RTT sample */
+#define MIN_TIMEOUT 50
+#define MAX_TIMEOUT 1000
+#define MIN_RTT_WINDOW 10000
+
+using namespace std;
+
+/* Default constructor */
+Controller::Controller( const bool debug )
+  : debug_( debug ),
+    rtt_estimator_( TIMEOUT, MIN_TIMEOUT, MAX_TIMEOUT, MIN_RTT_WINDOW ),
+    intervals_(),
+    phase_( Phase::Starting ),
+    rate_( START_RATE ),
+    best_starting_rate_( START_RATE ),
+    best_starting_utility_( -numeric_limits<double>::infinity() ),
+    probe_step_( 0 ),
+    up_first_( true ),
+    probe_up_utility_( PROBE_PAIRS ),
+    probe_down_utility_( PROBE_PAIRS ),
+    probes_judged_( 0 ),
+    last_direction_( 0 ),
+    consecutive_steps_( 0 ),
+    boundary_steps_( 0 )
+{
+  /* the probe order is random so that competing flows don't probe in
+     lockstep */
+  srand( (unsigned) time( NULL ) );
+}
+
+/* The rate of the interval being sent */
+double Controller::current_rate( void ) const
+{
+  return intervals_.empty() ? rate_ : intervals_.back().rate;
+}
+
+/* Get current window size, in datagrams */
+unsigned int Controller::window_size( void )
+{
+  unsigned int the_window_size = START_WINDOW;
+  if ( rtt_estimator_.has_sample() ) {
+    the_window_size = max( MIN_CWND, WINDOW_GAIN * current_rate()
+			   * rtt_estimator_.min_rtt() / 1000.0 );
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " window size is " << the_window_size << endl;
+  }
+
+  return the_window_size;
+}
+
+/* Close the open interval and open the next one in the schedule */
+void Controller::start_interval( const uint64_t sequence_number, const uint64_t now )
+{
+  if ( not intervals_.empty() ) {
+    intervals_.back().end = now;
+  }
+
+  Role role = Role::Unevaluated;
+  const unsigned int pair = probe_step_ / 2;
+  double rate = rate_;
+
+  if ( phase_ == Phase::Starting ) {
+    /* (the first interval carries the initial window's burst, so it
+       says nothing about its rate) */
+    if ( rtt_estimator_.has_sample() ) {
+      role = Role::Starting;
+      rate_ *= 2;
+    }
+  } else {
+    if ( probe_step_ % 2 == 0 ) {
+      up_first_ = rand() % 2;
+    }
+    if ( pair < PROBE_PAIRS ) {
+      const bool up = (probe_step_ % 2 == 0) == up_first_;
+      role = up ? Role::ProbeUp : Role::ProbeDown;
+      rate = up ? rate_ * (1 + EPSILON) : rate_ * (1 - EPSILON);
+    }
+    probe_step_++;
+  }
+
+  /* an interval lasts a few round trips, and long enough to send a
+     few datagrams at its rate */
+  const double srtt = rtt_estimator_.has_sample() ? rtt_estimator_.srtt() : INITIAL_INTERVAL;
+  const uint64_t duration = max( INTERVAL_RTTS * srtt,
+				 MIN_INTERVAL_DATAGRAMS * 1000.0 / rate );
+
+  intervals_.push_back( MonitorInterval { role, pair, rate, now, 0, duration, sequence_number,
+					  0, 0, 0, 0, 0, 0, 0, 0 } );
+}
+
+/* A datagram was sent */
+void Controller::datagram_was_sent( const uint64_t sequence_number,
+				    /* of the sent datagram */
+				    const uint64_t send_timestamp )
+                                    /* in milliseconds */
+{
+  if ( intervals_.empty()
+       or send_timestamp >= intervals_.back().start + intervals_.back().duration ) {
+    start_interval( sequence_number, send_timestamp );
+  }
+  intervals_.back().sent++;
+
+  if ( debug_ ) {
+    cerr << "At time " << send_timestamp
+	 << " sent datagram " << sequence_number << endl;
+  }
+}
+
+/* The interval a datagram was sent in (nullptr if it is no longer tracked) */
+Controller::MonitorInterval * Controller::find_interval( const uint64_t sequence_number )
+{
+  for ( auto it = intervals_.rbegin(); it != intervals_.rend(); it++ ) {
+    if ( sequence_number >= it->first_sequence ) {
+      return sequence_number < it->first_sequence + it->sent ? &*it : nullptr;
+    }
+  }
+
+  return nullptr;
+}
+
+/* Vivace-Latency's utility of an interval */
+double Controller::utility( const MonitorInterval & interval ) const
+{
+  const double seconds = max( uint64_t( 1 ), interval.end - interval.start ) / 1000.0;
+  const double rate = interval.sent * DATAGRAM_BITS / seconds / 1e6;
+  const double loss = double( interval.lost ) / interval.sent;
+
+  /* least-squares slope of RTT against send time */
+  double gradient = 0;
+  const double n = interval.rtt_samples;
+  const double denominator = n * interval.sum_time_squared - interval.sum_time * interval.sum_time;
+  if ( n >= 2 and denominator > 0 ) {
+    gradient = (n * interval.sum_time_rtt - interval.sum_time * interval.sum_rtt) / denominator;
+  }
+  if ( fabs( gradient ) < GRADIENT_TOLERANCE ) {
+    gradient = 0;
+  }
+
+  return pow( rate, EXPONENT ) - LATENCY_COEFFICIENT * rate * gradient
+    - LOSS_COEFFICIENT * rate * loss;
+}
+
+/* Move the rate along the utility gradient the probe pairs measured */
+void Controller::step_rate( void )
+{
+  const double mbps = rate_ * DATAGRAM_BITS / 1e6;
+
+  double gamma = 0;
+  unsigned int ups = 0;
+  for ( unsigned int pair = 0; pair < PROBE_PAIRS; pair++ ) {
+    const double difference = probe_up_utility_[ pair ] - probe_down_utility_[ pair ];
+    gamma += difference / (2 * EPSILON * mbps) / PROBE_PAIRS;
+    ups += difference >= 0;
+  }
+
+  /* the link changed under the trials: stay, and lose confidence */
+  if ( ups != 0 and ups != PROBE_PAIRS ) {
+    last_direction_ = 0;
+    consecutive_steps_ = boundary_steps_ = 0;
+    return;
+  }
+
+  const int direction = gamma >= 0 ? 1 : -1;
+
+  /* confidence amplification: repeated steps the same way grow */
+  if ( direction == last_direction_ ) {
+    consecutive_steps_++;
+  } else {
+    consecutive_steps_ = 1;
+    boundary_steps_ = 0;
+  }
+  last_direction_ = direction;
+
+  double change = consecutive_steps_ * STEP_SIZE * gamma;
+
+  /* the dynamic change boundary: a step may be at most a fraction of
+     the rate, a fraction that grows while steps keep hitting it */
+  const double limit = (INITIAL_BOUNDARY + boundary_steps_ * BOUNDARY_GROWTH) * mbps;
+  if ( fabs( change ) > limit ) {
+    change = direction * limit;
+    boundary_steps_++;
+  } else {
+    boundary_steps_ = 0;
+  }
+
+  rate_ = max( MIN_RATE, rate_ + change * 1e6 / DATAGRAM_BITS );
+}
+
+/* Use an interval's verdict */
+void Controller::judge( const MonitorInterval & interval )
+{
+  const double u = utility( interval );
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " interval at " << interval.rate << " datagrams/s: " << interval.sent
+	 << " sent, " << interval.acked << " acked, " << interval.lost
+	 << " lost, utility " << u << endl;
+  }
+
+  switch ( interval.role ) {
+  case Role::Starting:
+    if ( u >= best_starting_utility_ ) {
+      best_starting_utility_ = u;
+      best_starting_rate_ = interval.rate;
+    } else {
+      /* utility fell: go back to the best rate and start probing */
+      phase_ = Phase::Probing;
+      rate_ = best_starting_rate_;
+      probe_step_ = probes_judged_ = 0;
+      for ( auto & later : intervals_ ) {
+	later.role = Role::Unevaluated;
+      }
+    }
+    break;
+  case Role::ProbeUp:
+    probe_up_utility_[ interval.pair ] = u;
+    probes_judged_++;
+    break;
+  case Role::ProbeDown:
+    probe_down_utility_[ interval.pair ] = u;
+    probes_judged_++;
+    break;
+  case Role::Unevaluated:
+    break;
+  }
+
+  if ( probes_judged_ == 2 * PROBE_PAIRS ) {
+    step_rate();
+    probes_judged_ = 0;
+    probe_step_ = 0;
+  }
+}
+
+/* Judge, in order, the closed intervals whose datagrams have all been
+   acked or declared lost */
+void Controller::finish_intervals( void )
+{
+  while ( not intervals_.empty() ) {
+    const MonitorInterval interval = intervals_.front();
+    if ( interval.end == 0 or interval.acked + interval.lost < interval.sent ) {
+      break;
+    }
+
+    intervals_.pop_front();
+    if ( interval.role != Role::Unevaluated ) {
+      judge( interval );
+    }
+  }
+}
+
+/* An ack was received */
+void Controller::ack_received( const uint64_t sequence_number_acked,
+			       /* what sequence number was acknowledged */
+			       const uint64_t send_timestamp_acked,
+			       /* when the acknowledged datagram was sent (sender's clock) */
+			       const uint64_t recv_timestamp_acked,
+			       /* when the acknowledged datagram was received (receiver's clock)*/
+			       const uint64_t timestamp_ack_received )
+                               /* when the ack was received (by sender) */
+{
+  const double rtt = timestamp_ack_received - send_timestamp_acked;
+  rtt_estimator_.sample( rtt, timestamp_ack_received );
+
+  MonitorInterval * interval = find_interval( sequence_number_acked );
+  if ( interval ) {
+    const double time = double( send_timestamp_acked ) - interval->start;
+    interval->acked++;
+    interval->rtt_samples++;
+    interval->sum_time += time;
+    interval->sum_rtt += rtt;
+    interval->sum_time_squared += time * time;
+    interval->sum_time_rtt += time * rtt;
+    finish_intervals();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ack_received
+	 << " received ack for datagram " << sequence_number_acked
+	 << " (send @ time " << send_timestamp_acked
+	 << ", received @ time " << recv_timestamp_acked << " by receiver's clock)"
+	 << endl;
+  }
+}
+
+/* The sender's scoreboard changed (after an ack or a timeout) */
+void Controller::flight_updated( const uint64_t datagrams_in_flight,
+				 /* sent, but neither acked nor lost */
+				 const uint64_t bytes_in_flight,
+				 const uint64_t delivered )
+                                 /* datagrams acked so far */
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " in flight: " << datagrams_in_flight
+	 << " datagrams (" << bytes_in_flight << " bytes)"
+	 << ", delivered: " << delivered << endl;
+  }
+}
+
+/* A datagram was declared lost (by the sender's loss detector) */
+void Controller::packet_lost( const uint64_t sequence_number,
+			      /* of the lost datagram */
+			      const uint64_t send_timestamp )
+                              /* when it was sent, in milliseconds */
+{
+  MonitorInterval * interval = find_interval( sequence_number );
+  if ( interval ) {
+    interval->lost++;
+    finish_intervals();
+  }
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " datagram " << sequence_number
+	 << " (sent @ time " << send_timestamp << ") was lost" << endl;
+  }
+}
+
+/* A delivery-rate sample was taken (on an ack) */
+void Controller::delivery_rate_sampled( const RateSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " delivery rate " << sample.delivery_rate << " datagrams/s ("
+	 << sample.delivered << " datagrams over " << sample.interval << " ms)" << endl;
+  }
+}
+
+/* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+void Controller::ecn_sampled( const EcnSample & sample )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "At time " << timestamp_ms()
+	 << " " << sample.ce_marked << " of " << sample.acked
+	 << " acks in the last window echoed CE" << endl;
+  }
+}
+
+/* How long to wait (in milliseconds) if there are no acks
+   before sending one more datagram */
+unsigned int Controller::timeout_ms( void )
+{
+  return rtt_estimator_.rto();
+}
+
+/* The timeout expired with no acks */
+void Controller::timeout_expired( void )
+{
+  rtt_estimator_.timed_out();
+
+  /* the intervals in flight can no longer be judged fairly: start
+     over from half the rate */
+  rate_ = best_starting_rate_ = max( MIN_RATE, current_rate() / 2 );
+  best_starting_utility_ = -numeric_limits<double>::infinity();
+  intervals_.clear();
+  phase_ = Phase::Starting;
+  probe_step_ = 0;
+  probes_judged_ = 0;
+}
+
+/* Rate at which a paced sender should release datagrams
+   (datagrams per second; 0 means unpaced) */
+double Controller::pacing_rate( void )
+{
+  return current_rate();
+}
+
+/* Whether the sender paces (told once, before the first datagram) */
+void Controller::set_paced( const bool paced )
+{
+  /* Default: take no action */
+
+  if ( debug_ ) {
+    cerr << "Sender is " << ( paced ? "paced" : "unpaced" ) << endl;
+  }
+}
@@ -0,0 +1,118 @@
+#ifndef CONTROLLER_HH
+#define CONTROLLER_HH
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "estimators.hh"
+#include "rtt_estimator.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+
+/* Congestion controller interface */
+
+class Controller
+{
+private:
+  bool debug_; /* Enables debugging output */
+
+  /* Add member variables here */
+  RttEstimator rtt_estimator_;
+
+  /* A stretch of sending at one rate, judged by the acks and losses of
+     the datagrams sent during it */
+  enum class Role { Unevaluated, Starting, ProbeUp, ProbeDown };
+  struct MonitorInterval {
+    Role role;
+    unsigned int pair;        /* which probe pair (if probing) */
+    double rate;              /* datagrams per second */
+    uint64_t start, end;      /* send times, ms (end is 0 while open) */
+    uint64_t duration;        /* planned, ms */
+    uint64_t first_sequence;  /* datagrams sent during the interval */
+    uint64_t sent, acked, lost;
+    double rtt_samples, sum_time, sum_rtt, sum_time_squared, sum_time_rtt;
+  };
+  std::deque<MonitorInterval> intervals_; /* oldest first, the last one open */
+
+  enum class Phase { Starting, Probing };
+  Phase phase_;
+  double rate_; /* datagrams per second */
+
+  /* Starting: the rate doubles every interval until utility falls */
+  double best_starting_rate_;
+  double best_starting_utility_;
+
+  /* Probing: pairs of intervals at rate_ * (1 +/- epsilon), each in
+     random order, then intervals at rate_ until all have been judged.
+     The rate moves only if every pair agrees on the direction. */
+  unsigned int probe_step_;
+  bool up_first_;
+  std::vector<double> probe_up_utility_, probe_down_utility_; /* per pair */
+  unsigned int probes_judged_;
+
+  /* confidence amplification and the dynamic change boundary */
+  int last_direction_;
+  unsigned int consecutive_steps_;
+  unsigned int boundary_steps_;
+
+  double current_rate( void ) const;
+  void start_interval( const uint64_t sequence_number, const uint64_t now );
+  MonitorInterval * find_interval( const uint64_t sequence_number );
+  void finish_intervals( void );
+  double utility( const MonitorInterval & interval ) const;
+  void judge( const MonitorInterval & interval );
+  void step_rate( void );
+
+public:
+  /* Public interface for the congestion controller */
+  /* You can change these if you prefer, but will need to change
+     the call site as well (in sender.cc) */
+
+  /* Default constructor */
+  Controller( const bool debug );
+
+  /* Get current window size, in datagrams */
+  unsigned int window_size( void );
+
+  /* A datagram was sent */
+  void datagram_was_sent( const uint64_t sequence_number,
+			  const uint64_t send_timestamp );
+
+  /* An ack was received */
+  void ack_received( const uint64_t sequence_number_acked,
+		     const uint64_t send_timestamp_acked,
+		     const uint64_t recv_timestamp_acked,
+		     const uint64_t timestamp_ack_received );
+
+  /* The sender's scoreboard changed (after an ack or a timeout) */
+  void flight_updated( const uint64_t datagrams_in_flight,
+		       const uint64_t bytes_in_flight,
+		       const uint64_t delivered );
+
+  /* A datagram was declared lost */
+  void packet_lost( const uint64_t sequence_number,
+		    const uint64_t send_timestamp );
+
+  /* A delivery-rate sample was taken (on an ack) */
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A window's worth of ECN feedback was tallied (sender run with ecn or l4s) */
+  void ecn_sampled( const EcnSample & sample );
+
+  /* How long to wait (in milliseconds) if there are no acks
+     before sending one more datagram */
+  unsigned int timeout_ms( void );
+
+  /* The timeout expired with no acks */
+  void timeout_expired( void );
+
+  /* Rate at which a paced sender should release datagrams
+     (datagrams per second; 0 means unpaced) */
+  double pacing_rate( void );
+
+  /* Whether the sender paces (told once, before the first datagram) */
+  void set_paced( const bool paced );
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "ecn_counter.hh"
+#include "socket.hh"
+
+using namespace std;
+
+EcnCounter::EcnCounter( const bool enabled )
+  : capable_( enabled ),
+    window_started_( false ),
+    window_end_( 0 ),
+    acked_( 0 ),
+    ce_marked_( 0 ),
+    ect_echoed_( 0 ),
+    total_ce_marked_( 0 )
+{}
+
+bool EcnCounter::acked( const uint64_t sequence_number,
+			const uint8_t ecn,
+			const uint64_t next_sequence,
+			EcnSample & sample )
+{
+  if ( not capable_ ) {
+    return false;
+  }
+
+  acked_++;
+  ect_echoed_ += ecn != UDPSocket::NOT_ECT;
+  if ( ecn == UDPSocket::CE ) {
+    ce_marked_++;
+    total_ce_marked_++;
+  }
+
+  /* the first window runs from the first ack, so that a single ack
+     (say, one sent before the receiver echoed anything) can't decide
+     whether ECN works */
+  if ( not window_started_ ) {
+    window_started_ = true;
+    window_end_ = next_sequence;
+    return false;
+  }
+
+  if ( sequence_number < window_end_ ) {
+    return false;
+  }
+
+  if ( ect_echoed_ == 0 ) {
+    capable_ = false;
+    return false;
+  }
+
+  sample = EcnSample { acked_, ce_marked_, double( ce_marked_ ) / acked_ };
+
+  window_end_ = next_sequence;
+  acked_ = ce_marked_ = ect_echoed_ = 0;
+  return true;
+}
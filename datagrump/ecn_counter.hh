@@ -0,0 +1,51 @@
+#ifndef ECN_COUNTER_HH
+#define ECN_COUNTER_HH
+
+#include <cstdint>
+
+/* ECN feedback over one window of data */
+struct EcnSample {
+  uint64_t acked;      /* acks in the window */
+  uint64_t ce_marked;  /* of those, datagrams that arrived marked CE */
+  double ce_fraction;  /* ce_marked / acked */
+};
+
+/* Tallies the ECN bits the receiver echoes, a window of data at a time
+   as DCTCP does: a window ends with the ack of the first datagram sent
+   after it began. The first window begins with the first ack. If a
+   whole window comes back without ECT or CE (the path or the receiver
+   bleaches the bits), ECN is given up as RFC 9000 does, and no more
+   samples are taken. */
+class EcnCounter
+{
+private:
+  bool capable_;
+
+  bool window_started_;  /* false until the first ack */
+  uint64_t window_end_; /* the window ends with this sequence number's ack */
+  uint64_t acked_;
+  uint64_t ce_marked_;
+  uint64_t ect_echoed_; /* acks that echoed ECT(0), ECT(1) or CE */
+
+  uint64_t total_ce_marked_;
+
+public:
+  /* enabled: the sender marks its datagrams ECT */
+  EcnCounter( const bool enabled );
+
+  /* An ack echoed the ECN bits its datagram arrived with; next_sequence
+     is the next sequence number the sender will use. Returns whether
+     the ack ended a window (and filled in the sample). */
+  bool acked( const uint64_t sequence_number,
+	      const uint8_t ecn,
+	      const uint64_t next_sequence,
+	      EcnSample & sample );
+
+  /* Is ECN still in use? */
+  bool capable( void ) const { return capable_; }
+
+  /* CE marks seen so far */
+  uint64_t ce_marked( void ) const { return total_ce_marked_; }
+};
+
+#endif
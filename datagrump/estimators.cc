@@ -0,0 +1,38 @@
+#include "estimators.hh"
+
+using namespace std;
+
+Ewma::Ewma( const double alpha )
+  : alpha_( alpha ),
+    value_( 0 ),
+    has_value_( false )
+{}
+
+double Ewma::update( const double sample )
+{
+  value_ = has_value_ ? alpha_ * sample + (1 - alpha_) * value_ : sample;
+  has_value_ = true;
+  return value_;
+}
+
+DelayGradient::DelayGradient( const double alpha )
+  : difference_( alpha ),
+    previous_( 0 ),
+    has_previous_( false )
+{}
+
+void DelayGradient::update( const double delay )
+{
+  if ( has_previous_ ) {
+    difference_.update( delay - previous_ );
+  }
+
+  previous_ = delay;
+  has_previous_ = true;
+}
+
+/* The gradient relative to a base delay (e.g. the minimum RTT) */
+double DelayGradient::normalized( const double base_delay ) const
+{
+  return base_delay > 0 ? get() / base_delay : 0;
+}
@@ -0,0 +1,136 @@
+#ifndef ESTIMATORS_HH
+#define ESTIMATORS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/* Signal estimators shared by the controllers. Each costs O(1) per
+   sample and allocates nothing after construction. */
+
+/* Exponentially weighted moving average: each sample moves the average
+   a fixed fraction (alpha) of the way towards it. The first sample
+   initializes the average. */
+class Ewma
+{
+private:
+  double alpha_;
+  double value_;
+  bool has_value_;
+
+public:
+  Ewma( const double alpha );
+
+  double update( const double sample );
+
+  /* The average (0 until the first sample) */
+  double get( void ) const { return value_; }
+  bool has_value( void ) const { return has_value_; }
+};
+
+/* Kathleen Nichols' windowed min/max filter (as in Linux's
+   lib/win_minmax.c): the best sample seen over a sliding window of
+   time, kept with the best samples from the second and last quarters
+   of the window so it can expire without storing the whole window.
+   Better is std::greater_equal for a max filter, std::less_equal for a
+   min filter. The window may be in any unit (ms, round trips). */
+template <class Better>
+class WindowedFilter
+{
+private:
+  struct Sample {
+    double value;
+    uint64_t time;
+  };
+
+  uint64_t window_;
+  Sample estimates_[ 3 ]; /* best, second best, third best */
+  bool has_value_;
+  Better better_;
+
+  void reset( const Sample & sample )
+  {
+    estimates_[ 0 ] = estimates_[ 1 ] = estimates_[ 2 ] = sample;
+    has_value_ = true;
+  }
+
+public:
+  WindowedFilter( const uint64_t window )
+    : window_( window ), estimates_(), has_value_( false ), better_()
+  {}
+
+  double update( const double value, const uint64_t time )
+  {
+    const Sample sample { value, time };
+
+    /* a new best, or every estimate has left the window */
+    if ( not has_value_ or better_( value, estimates_[ 0 ].value )
+	 or time - estimates_[ 2 ].time > window_ ) {
+      reset( sample );
+      return get();
+    }
+
+    if ( better_( value, estimates_[ 1 ].value ) ) {
+      estimates_[ 2 ] = estimates_[ 1 ] = sample;
+    } else if ( better_( value, estimates_[ 2 ].value ) ) {
+      estimates_[ 2 ] = sample;
+    }
+
+    /* expire the best estimate, or refresh the others when they have
+       gone a quarter (or half) of the window without changing */
+    const uint64_t age = time - estimates_[ 0 ].time;
+    if ( age > window_ ) {
+      estimates_[ 0 ] = estimates_[ 1 ];
+      estimates_[ 1 ] = estimates_[ 2 ];
+      estimates_[ 2 ] = sample;
+      if ( time - estimates_[ 0 ].time > window_ ) {
+	estimates_[ 0 ] = estimates_[ 1 ];
+	estimates_[ 1 ] = estimates_[ 2 ];
+	estimates_[ 2 ] = sample;
+      }
+    } else if ( estimates_[ 1 ].time == estimates_[ 0 ].time
+		and age > window_ / 4 ) {
+      estimates_[ 2 ] = estimates_[ 1 ] = sample;
+    } else if ( estimates_[ 2 ].time == estimates_[ 1 ].time
+		and age > window_ / 2 ) {
+      estimates_[ 2 ] = sample;
+    }
+
+    return get();
+  }
+
+  /* The best sample in the window (0 until the first sample) */
+  double get( void ) const { return has_value_ ? estimates_[ 0 ].value : 0; }
+  bool has_value( void ) const { return has_value_; }
+
+  /* Resize the window (e.g. one that follows the RTT); takes effect
+     at the next sample */
+  void set_window( const uint64_t window ) { window_ = window; }
+};
+
+typedef WindowedFilter<std::less_equal<double>> WindowedMinFilter;
+typedef WindowedFilter<std::greater_equal<double>> WindowedMaxFilter;
+
+/* Trend of a delay signal, as in TIMELY: a smoothed difference between
+   consecutive samples. Positive means delay is building, negative that
+   queues are draining. */
+class DelayGradient
+{
+private:
+  Ewma difference_;
+  double previous_;
+  bool has_previous_;
+
+public:
+  DelayGradient( const double alpha );
+
+  void update( const double delay );
+
+  /* Smoothed change in delay per sample */
+  double get( void ) const { return difference_.get(); }
+
+  /* The gradient relative to a base delay (e.g. the minimum RTT) */
+  double normalized( const double base_delay ) const;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <algorithm>
+
+#include "loss_detector.hh"
+
+using namespace std;
+
+/* how long a minimum RTT sample stays current (milliseconds) */
+static const uint64_t MIN_RTT_WINDOW = 10000;
+
+/* the tail-loss probe waits this many smoothed RTTs... */
+static const double PROBE_SRTTS = 2.0;
+
+/* ...but never less than this (milliseconds) */
+static const uint64_t MIN_PROBE_TIMEOUT = 10;
+
+static const uint64_t NO_TIMER = -1;
+
+LossDetector::LossDetector()
+  : outstanding_(),
+    have_rack_( false ),
+    rack_sequence_number_( 0 ),
+    rack_rtt_( 0 ),
+    /* the detector sets its own timers, so the RTO bounds don't matter */
+    rtt_estimator_( 1000, 1, 60000, MIN_RTT_WINDOW ),
+    last_send_timestamp_( 0 ),
+    probe_sent_( false ),
+    lost_()
+{}
+
+/* A datagram was sent */
+void LossDetector::sent( const uint64_t sequence_number,
+			 const uint64_t send_timestamp )
+{
+  outstanding_.sent( sequence_number, send_timestamp );
+  last_send_timestamp_ = send_timestamp;
+}
+
+/* A datagram was acked */
+void LossDetector::acked( const uint64_t sequence_number,
+			  const uint64_t send_timestamp,
+			  const uint64_t ack_timestamp )
+{
+  outstanding_.acked( sequence_number );
+  probe_sent_ = false;
+
+  const uint64_t rtt = ack_timestamp - send_timestamp;
+  rtt_estimator_.sample( rtt, ack_timestamp );
+
+  /* datagrams are sent in sequence order, so the highest sequence
+     number acked is the most recently sent datagram delivered */
+  if ( not have_rack_ or sequence_number >= rack_sequence_number_ ) {
+    have_rack_ = true;
+    rack_sequence_number_ = sequence_number;
+    rack_rtt_ = rtt;
+  }
+}
+
+/* a quarter of the minimum RTT, and at least one clock tick */
+uint64_t LossDetector::reordering_window( void ) const
+{
+  return max( uint64_t( 1 ), rtt_estimator_.min_rtt() / 4 );
+}
+
+/* when the oldest datagram sent before the last one acked will be lost */
+uint64_t LossDetector::reordering_deadline( void ) const
+{
+  if ( not have_rack_ or outstanding_.empty()
+       or outstanding_.oldest_sequence_number() >= rack_sequence_number_ ) {
+    return NO_TIMER;
+  }
+
+  return outstanding_.oldest_send_timestamp() + rack_rtt_ + reordering_window();
+}
+
+/* when to probe for losses at the tail of the flight */
+uint64_t LossDetector::probe_deadline( void ) const
+{
+  if ( probe_sent_ or not rtt_estimator_.has_sample() or outstanding_.empty() ) {
+    return NO_TIMER;
+  }
+
+  return last_send_timestamp_
+    + max( MIN_PROBE_TIMEOUT, uint64_t( PROBE_SRTTS * rtt_estimator_.srtt() ) );
+}
+
+/* Datagrams newly found lost as of now */
+const vector<LossDetector::LostDatagram> & LossDetector::detect_losses( const uint64_t now )
+{
+  lost_.clear();
+
+  /* send times rise with sequence numbers, so once the oldest datagram
+     isn't overdue, nothing sent after it is either */
+  while ( reordering_deadline() <= now ) {
+    lost_.push_back( { outstanding_.oldest_sequence_number(),
+		       outstanding_.oldest_send_timestamp() } );
+    outstanding_.pop_oldest();
+  }
+
+  return lost_;
+}
+
+/* Should the sender send a tail-loss probe now? (only says yes once) */
+bool LossDetector::tail_loss_probe_due( const uint64_t now )
+{
+  if ( probe_deadline() > now ) {
+    return false;
+  }
+
+  probe_sent_ = true;
+  return true;
+}
+
+/* Every outstanding datagram, now presumed lost (after a timeout) */
+const vector<LossDetector::LostDatagram> & LossDetector::declare_all_lost( void )
+{
+  lost_.clear();
+
+  while ( not outstanding_.empty() ) {
+    lost_.push_back( { outstanding_.oldest_sequence_number(),
+		       outstanding_.oldest_send_timestamp() } );
+    outstanding_.pop_oldest();
+  }
+
+  return lost_;
+}
+
+/* When to call detect_losses() or tail_loss_probe_due() next */
+uint64_t LossDetector::next_timer( void ) const
+{
+  return min( reordering_deadline(), probe_deadline() );
+}
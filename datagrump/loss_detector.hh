@@ -0,0 +1,70 @@
+#ifndef LOSS_DETECTOR_HH
+#define LOSS_DETECTOR_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "outstanding_packets.hh"
+#include "rtt_estimator.hh"
+
+/* Time-based loss detection in the style of RACK (RFC 8985), plus
+   tail-loss probes. Once a datagram is acked, any datagram sent
+   before it is declared lost when it has been outstanding for that
+   ack's RTT plus a reordering window (a quarter of the minimum RTT).
+   When the last datagrams of a flight go unacked for about two
+   smoothed RTTs, the sender should send one probe, so that its ack
+   can reveal the losses well before the retransmission timeout.
+   Times are in milliseconds. */
+class LossDetector
+{
+public:
+  struct LostDatagram {
+    uint64_t sequence_number;
+    uint64_t send_timestamp;
+  };
+
+private:
+  OutstandingPackets outstanding_;
+
+  /* the most recently sent datagram that has been acked, and its RTT */
+  bool have_rack_;
+  uint64_t rack_sequence_number_;
+  uint64_t rack_rtt_;
+
+  RttEstimator rtt_estimator_; /* minimum and smoothed RTT */
+
+  uint64_t last_send_timestamp_;
+  bool probe_sent_; /* at most one tail-loss probe between acks */
+
+  std::vector<LostDatagram> lost_; /* reused to avoid allocating */
+
+  uint64_t reordering_window( void ) const;
+  uint64_t reordering_deadline( void ) const;
+  uint64_t probe_deadline( void ) const;
+
+public:
+  LossDetector();
+
+  /* A datagram was sent */
+  void sent( const uint64_t sequence_number, const uint64_t send_timestamp );
+
+  /* A datagram was acked */
+  void acked( const uint64_t sequence_number,
+	      const uint64_t send_timestamp,
+	      const uint64_t ack_timestamp );
+
+  /* Datagrams newly found lost as of now */
+  const std::vector<LostDatagram> & detect_losses( const uint64_t now );
+
+  /* Should the sender send a tail-loss probe now? (only says yes once) */
+  bool tail_loss_probe_due( const uint64_t now );
+
+  /* Every outstanding datagram, now presumed lost (after a timeout) */
+  const std::vector<LostDatagram> & declare_all_lost( void );
+
+  /* When to call detect_losses() or tail_loss_probe_due() next
+     (-1 if nothing is pending) */
+  uint64_t next_timer( void ) const;
+};
+
+#endif
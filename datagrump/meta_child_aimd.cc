@@ -0,0 +1,7 @@
+/* controller_aimd.cc, compiled as the meta-controller's AimdController
+   (see meta_children.hh) */
+
+#undef CONTROLLER_HH
+#define Controller AimdController
+#include "controller_aimd.hh"
+#include "controller_aimd.cc"
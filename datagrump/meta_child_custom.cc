@@ -0,0 +1,7 @@
+/* controller_custom.cc, compiled as the meta-controller's CustomController
+   (see meta_children.hh) */
+
+#undef CONTROLLER_HH
+#define Controller CustomController
+#include "controller_custom.hh"
+#include "controller_custom.cc"
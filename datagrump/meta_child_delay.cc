@@ -0,0 +1,7 @@
+/* controller_delay.cc, compiled as the meta-controller's DelayController
+   (see meta_children.hh) */
+
+#undef CONTROLLER_HH
+#define Controller DelayController
+#include "controller_delay.hh"
+#include "controller_delay.cc"
@@ -0,0 +1,7 @@
+/* controller_fixed_window.cc, compiled as the meta-controller's FixedWindowController
+   (see meta_children.hh) */
+
+#undef CONTROLLER_HH
+#define Controller FixedWindowController
+#include "controller_fixed_window.hh"
+#include "controller_fixed_window.cc"
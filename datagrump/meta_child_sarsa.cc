@@ -0,0 +1,7 @@
+/* controller_sarsa.cc, compiled as the meta-controller's SarsaController
+   (see meta_children.hh) */
+
+#undef CONTROLLER_HH
+#define Controller SarsaController
+#include "controller_sarsa.hh"
+#include "controller_sarsa.cc"
@@ -0,0 +1,35 @@
+#ifndef META_CHILDREN_HH
+#define META_CHILDREN_HH
+
+/* The controllers the meta-controller hosts. Each part.sh variant
+   declares the same class Controller under the same include guard, so
+   each is compiled a second time under a name of its own: the headers
+   here, with the guard cleared before each, and the sources in
+   meta_child_*.cc. The controllers themselves are unchanged. */
+
+#undef CONTROLLER_HH
+#define Controller FixedWindowController
+#include "controller_fixed_window.hh"
+#undef Controller
+
+#undef CONTROLLER_HH
+#define Controller AimdController
+#include "controller_aimd.hh"
+#undef Controller
+
+#undef CONTROLLER_HH
+#define Controller DelayController
+#include "controller_delay.hh"
+#undef Controller
+
+#undef CONTROLLER_HH
+#define Controller CustomController
+#include "controller_custom.hh"
+#undef Controller
+
+#undef CONTROLLER_HH
+#define Controller SarsaController
+#include "controller_sarsa.hh"
+#undef Controller
+
+#endif
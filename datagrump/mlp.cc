@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined( __GNUC__ ) and ( defined( __x86_64__ ) or defined( __i386__ ) )
+#define MLP_X86 1
+#include <immintrin.h>
+#endif
+
+#include "mlp.hh"
+
+#define LANES 8 /* floats per AVX2 vector; rows are padded to this */
+#define MAX_LAYER_SIZE 4096
+
+using namespace std;
+
+static size_t padded( const size_t count )
+{
+  return (count + LANES - 1) / LANES * LANES;
+}
+
+/* y[o] = w[o] . x + b[o], one row at a time */
+static void dense_scalar( const float * weights, const float * biases, const float * input,
+			  float * output, const size_t stride, const size_t outputs )
+{
+  for ( size_t o = 0; o < outputs; o++ ) {
+    const float * row = weights + o * stride;
+    float sum = 0;
+    for ( size_t i = 0; i < stride; i++ ) {
+      sum += row[ i ] * input[ i ];
+    }
+    output[ o ] = sum + biases[ o ];
+  }
+}
+
+#ifdef MLP_X86
+static void dense_sse( const float * weights, const float * biases, const float * input,
+		       float * output, const size_t stride, const size_t outputs )
+{
+  for ( size_t o = 0; o < outputs; o++ ) {
+    const float * row = weights + o * stride;
+    __m128 low = _mm_setzero_ps(), high = _mm_setzero_ps();
+    for ( size_t i = 0; i < stride; i += LANES ) {
+      low = _mm_add_ps( low, _mm_mul_ps( _mm_loadu_ps( row + i ), _mm_loadu_ps( input + i ) ) );
+      high = _mm_add_ps( high, _mm_mul_ps( _mm_loadu_ps( row + i + 4 ),
+					   _mm_loadu_ps( input + i + 4 ) ) );
+    }
+    float lanes[ 4 ];
+    _mm_storeu_ps( lanes, _mm_add_ps( low, high ) );
+    output[ o ] = (lanes[ 0 ] + lanes[ 1 ]) + (lanes[ 2 ] + lanes[ 3 ]) + biases[ o ];
+  }
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+static void dense_avx2( const float * weights, const float * biases, const float * input,
+			float * output, const size_t stride, const size_t outputs )
+{
+  for ( size_t o = 0; o < outputs; o++ ) {
+    const float * row = weights + o * stride;
+    __m256 sum = _mm256_setzero_ps();
+    for ( size_t i = 0; i < stride; i += LANES ) {
+      sum = _mm256_fmadd_ps( _mm256_loadu_ps( row + i ), _mm256_loadu_ps( input + i ), sum );
+    }
+    const __m128 half = _mm_add_ps( _mm256_castps256_ps128( sum ),
+				    _mm256_extractf128_ps( sum, 1 ) );
+    float lanes[ 4 ];
+    _mm_storeu_ps( lanes, half );
+    output[ o ] = (lanes[ 0 ] + lanes[ 1 ]) + (lanes[ 2 ] + lanes[ 3 ]) + biases[ o ];
+  }
+}
+#endif
+
+static Mlp::Kernel best_kernel( void )
+{
+#ifdef MLP_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) and __builtin_cpu_supports( "fma" ) ) {
+    return Mlp::Kernel::Avx2;
+  }
+  if ( __builtin_cpu_supports( "sse" ) ) {
+    return Mlp::Kernel::Sse;
+  }
+#endif
+  return Mlp::Kernel::Scalar;
+}
+
+Mlp::Mlp()
+  : layers_(),
+    kernel_( best_kernel() ),
+    input_(),
+    output_(),
+    result_()
+{}
+
+void Mlp::add_layer( const size_t inputs, const size_t outputs,
+		     const vector<float> & weights, const vector<float> & biases )
+{
+  if ( inputs == 0 or outputs == 0 or inputs > MAX_LAYER_SIZE or outputs > MAX_LAYER_SIZE ) {
+    throw runtime_error( "mlp: bad layer size" );
+  }
+  if ( not layers_.empty() and layers_.back().outputs != inputs ) {
+    throw runtime_error( "mlp: layer inputs don't match the previous layer's outputs" );
+  }
+  if ( weights.size() != inputs * outputs or biases.size() != outputs ) {
+    throw runtime_error( "mlp: wrong number of weights or biases" );
+  }
+
+  Layer layer { inputs, outputs, padded( inputs ),
+		vector<float>( outputs * padded( inputs ), 0 ), biases };
+  for ( size_t o = 0; o < outputs; o++ ) {
+    copy( weights.begin() + o * inputs, weights.begin() + (o + 1) * inputs,
+	  layer.weights.begin() + o * layer.stride );
+  }
+  layers_.push_back( layer );
+
+  /* the padding lanes stay 0, so they add nothing to the dot products */
+  size_t widest = 0;
+  for ( const Layer & each : layers_ ) {
+    widest = max( widest, max( each.stride, padded( each.outputs ) ) );
+  }
+  input_.assign( widest, 0 );
+  output_.assign( widest, 0 );
+}
+
+Mlp Mlp::load( const string & path )
+{
+  ifstream file( path, ios::binary );
+  if ( not file ) {
+    throw runtime_error( "mlp: cannot read " + path );
+  }
+
+  auto read = [&]( void * data, const size_t length ) {
+    if ( not file.read( static_cast<char *>( data ), length ) ) {
+      throw runtime_error( "mlp: " + path + " is truncated" );
+    }
+  };
+
+  char magic[ 4 ];
+  read( magic, sizeof( magic ) );
+  if ( memcmp( magic, "MLP1", sizeof( magic ) ) ) {
+    throw runtime_error( "mlp: " + path + " is not a network (bad magic)" );
+  }
+
+  uint32_t layer_count;
+  read( &layer_count, sizeof( layer_count ) );
+
+  Mlp network;
+  for ( uint32_t layer = 0; layer < layer_count; layer++ ) {
+    uint32_t inputs, outputs;
+    read( &inputs, sizeof( inputs ) );
+    read( &outputs, sizeof( outputs ) );
+    if ( inputs == 0 or outputs == 0 or inputs > MAX_LAYER_SIZE or outputs > MAX_LAYER_SIZE ) {
+      throw runtime_error( "mlp: " + path + " has a bad layer size" );
+    }
+
+    vector<float> weights( size_t( inputs ) * outputs ), biases( outputs );
+    read( weights.data(), weights.size() * sizeof( float ) );
+    read( biases.data(), biases.size() * sizeof( float ) );
+    network.add_layer( inputs, outputs, weights, biases );
+  }
+
+  if ( network.layers_.empty() ) {
+    throw runtime_error( "mlp: " + path + " has no layers" );
+  }
+
+  return network;
+}
+
+void Mlp::dense( const Layer & layer, const float * input, float * output ) const
+{
+  switch ( kernel_ ) {
+#ifdef MLP_X86
+  case Kernel::Avx2:
+    dense_avx2( layer.weights.data(), layer.biases.data(), input, output,
+		layer.stride, layer.outputs );
+    return;
+  case Kernel::Sse:
+    dense_sse( layer.weights.data(), layer.biases.data(), input, output,
+	       layer.stride, layer.outputs );
+    return;
+#endif
+  default:
+    dense_scalar( layer.weights.data(), layer.biases.data(), input, output,
+		  layer.stride, layer.outputs );
+  }
+}
+
+const vector<float> & Mlp::evaluate( const vector<float> & input )
+{
+  if ( input.size() != inputs() ) {
+    throw runtime_error( "mlp: wrong number of inputs" );
+  }
+
+  copy( input.begin(), input.end(), input_.begin() );
+  fill( input_.begin() + input.size(), input_.end(), 0 );
+
+  for ( size_t index = 0; index < layers_.size(); index++ ) {
+    const Layer & layer = layers_[ index ];
+    dense( layer, input_.data(), output_.data() );
+
+    /* tanh through expf, which costs a fraction of tanhf (it saturates
+       correctly when expf overflows or underflows) */
+    const bool hidden = index + 1 < layers_.size();
+    for ( size_t o = 0; o < layer.outputs; o++ ) {
+      input_[ o ] = hidden ? 1 - 2 / (1 + expf( 2 * output_[ o ] )) : output_[ o ];
+    }
+    fill( input_.begin() + layer.outputs, input_.end(), 0 );
+  }
+
+  result_.assign( input_.begin(), input_.begin() + outputs() );
+  return result_;
+}
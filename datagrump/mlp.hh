@@ -0,0 +1,61 @@
+#ifndef MLP_HH
+#define MLP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* A small multilayer perceptron for congestion-control policies: dense
+   layers, tanh on the hidden layers and a linear output layer. Each
+   weight row is padded to a multiple of 8 floats so that the dense
+   layers run in whole AVX2 (or SSE) vectors; the kernel is picked once,
+   from what the CPU supports, with a scalar fallback.
+
+   The binary form (host byte order) is the magic "MLP1", a uint32
+   layer count, then per layer a uint32 input count, a uint32 output
+   count, the float32 weights row by row (one row per output) and the
+   float32 biases. */
+class Mlp
+{
+public:
+  enum class Kernel { Scalar, Sse, Avx2 };
+
+private:
+  struct Layer {
+    size_t inputs, outputs;
+    size_t stride;                /* inputs, rounded up to a multiple of 8 */
+    std::vector<float> weights;   /* outputs rows of stride floats */
+    std::vector<float> biases;
+  };
+
+  std::vector<Layer> layers_;
+  Kernel kernel_;
+
+  /* activations, padded like the rows (reused on every evaluation) */
+  std::vector<float> input_, output_;
+  std::vector<float> result_;
+
+  void dense( const Layer & layer, const float * input, float * output ) const;
+
+public:
+  Mlp();
+
+  /* Load a network in the binary form above */
+  static Mlp load( const std::string & path );
+
+  /* Append a layer; weights has outputs rows of inputs floats */
+  void add_layer( const size_t inputs, const size_t outputs,
+		  const std::vector<float> & weights, const std::vector<float> & biases );
+
+  /* Run the network; input must have inputs() values */
+  const std::vector<float> & evaluate( const std::vector<float> & input );
+
+  size_t inputs( void ) const { return layers_.empty() ? 0 : layers_.front().inputs; }
+  size_t outputs( void ) const { return layers_.empty() ? 0 : layers_.back().outputs; }
+
+  Kernel kernel( void ) const { return kernel_; }
+  void set_kernel( const Kernel kernel ) { kernel_ = kernel; }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef OUTSTANDING_PACKETS_HH
+#define OUTSTANDING_PACKETS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Send times of unacknowledged datagrams, in a ring buffer indexed by
+   sequence number, each with whatever else its user needs to remember
+   about the datagram (Info). Datagrams are sent in sequence order, so
+   the ring is also the expiry queue: the oldest outstanding datagram is
+   always at the front. Sending, acking and expiring each cost O(1);
+   memory is only allocated when the ring has to grow. */
+template <class Info>
+class OutstandingRing
+{
+public:
+  struct Record {
+    uint64_t send_timestamp;
+    Info info;
+    bool outstanding;
+  };
+
+private:
+  std::vector<Record> ring_; /* size is a power of two */
+  uint64_t front_;           /* oldest sequence number in the ring */
+  uint64_t end_;             /* one past the newest sequence number sent */
+  size_t count_;             /* datagrams still outstanding */
+
+  Record & record( const uint64_t sequence_number )
+  {
+    return ring_[ sequence_number & (ring_.size() - 1) ];
+  }
+
+  /* double the ring, keeping records in sequence order */
+  void grow( void )
+  {
+    std::vector<Record> bigger( 2 * ring_.size(), Record() );
+    for ( uint64_t seq = front_; seq < end_; seq++ ) {
+      bigger[ seq & (bigger.size() - 1) ] = record( seq );
+    }
+    ring_.swap( bigger );
+  }
+
+  /* drop acked or expired records from the front */
+  void trim_front( void )
+  {
+    while ( front_ < end_ and not record( front_ ).outstanding ) {
+      front_++;
+    }
+  }
+
+public:
+  OutstandingRing()
+    : ring_( 64, Record() ), /* starting size (grows as needed) */
+      front_( 0 ),
+      end_( 0 ),
+      count_( 0 )
+  {}
+
+  /* A datagram was sent */
+  void sent( const uint64_t sequence_number, const uint64_t send_timestamp,
+	     const Info & info = Info() )
+  {
+    if ( sequence_number < end_ ) {
+      return; /* already tracked (or long gone) */
+    }
+
+    /* an empty ring can start over at any sequence number */
+    if ( empty() ) {
+      front_ = end_ = sequence_number;
+    }
+
+    while ( sequence_number - front_ >= ring_.size() ) {
+      grow();
+    }
+
+    /* skipped sequence numbers were never sent */
+    for ( ; end_ < sequence_number; end_++ ) {
+      record( end_ ).outstanding = false;
+    }
+
+    record( sequence_number ) = Record { send_timestamp, info, true };
+    end_ = sequence_number + 1;
+    count_++;
+  }
+
+  /* A datagram was acked; returns whether it was still outstanding */
+  bool acked( const uint64_t sequence_number )
+  {
+    if ( not find( sequence_number ) ) {
+      return false;
+    }
+
+    record( sequence_number ).outstanding = false;
+    count_--;
+    trim_front();
+    return true;
+  }
+
+  /* A datagram was declared lost; returns whether it was still outstanding */
+  bool lost( const uint64_t sequence_number ) { return acked( sequence_number ); }
+
+  /* An outstanding datagram's record (nullptr if it isn't outstanding) */
+  const Record * find( const uint64_t sequence_number ) const
+  {
+    if ( sequence_number < front_ or sequence_number >= end_ ) {
+      return nullptr;
+    }
+
+    const Record & datagram = ring_[ sequence_number & (ring_.size() - 1) ];
+    return datagram.outstanding ? &datagram : nullptr;
+  }
+
+  /* Number of datagrams still outstanding */
+  size_t size( void ) const { return count_; }
+  bool empty( void ) const { return count_ == 0; }
+
+  /* The oldest outstanding datagram (only valid when not empty) */
+  uint64_t oldest_sequence_number( void ) const { return front_; }
+  uint64_t oldest_send_timestamp( void ) const
+  {
+    return ring_[ front_ & (ring_.size() - 1) ].send_timestamp;
+  }
+
+  /* Stop tracking the oldest outstanding datagram (e.g. it timed out) */
+  void pop_oldest( void )
+  {
+    if ( empty() ) {
+      return;
+    }
+
+    record( front_ ).outstanding = false;
+    count_--;
+    trim_front();
+  }
+};
+
+/* The send times alone */
+struct NoInfo {};
+typedef OutstandingRing<NoInfo> OutstandingPackets;
+
+#endif
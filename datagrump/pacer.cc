@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "pacer.hh"
+
+using namespace std;
+
+/* nanoseconds per second */
+static const double BILLION = 1e9;
+
+Pacer::Pacer( const double burst )
+  : rate_( 0 ),
+    burst_( max( 1.0, burst ) ),
+    tokens_( burst_ ),
+    last_update_ns_( 0 )
+{}
+
+/* add the tokens earned since the last update */
+void Pacer::refill( const uint64_t now_ns )
+{
+  if ( now_ns > last_update_ns_ ) {
+    tokens_ = min( burst_, tokens_ + rate_ * (now_ns - last_update_ns_) / BILLION );
+  }
+  last_update_ns_ = max( last_update_ns_, now_ns );
+}
+
+/* set the pacing rate, in datagrams per second */
+void Pacer::set_rate( const double rate, const uint64_t now_ns )
+{
+  /* tokens earned so far accrue at the old rate */
+  refill( now_ns );
+  rate_ = max( 0.0, rate );
+}
+
+/* earliest time (monotonic nanoseconds) the next datagram may leave */
+uint64_t Pacer::departure_time( const uint64_t now_ns )
+{
+  refill( now_ns );
+
+  if ( rate_ <= 0 or tokens_ >= 1 ) {
+    return now_ns;
+  }
+
+  return last_update_ns_ + uint64_t( (1 - tokens_) / rate_ * BILLION );
+}
+
+/* a datagram was released */
+void Pacer::datagram_sent( const uint64_t now_ns )
+{
+  refill( now_ns );
+
+  if ( rate_ > 0 ) {
+    tokens_ -= 1;
+  }
+}
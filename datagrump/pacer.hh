@@ -0,0 +1,32 @@
+#ifndef PACER_HH
+#define PACER_HH
+
+#include <cstdint>
+
+/* Token-bucket pacer: releases datagrams at the controller's pacing
+   rate, letting up to a burst allowance leave back-to-back */
+class Pacer
+{
+private:
+  double rate_;   /* datagrams per second (0 means unpaced) */
+  double burst_;  /* most tokens the bucket holds, in datagrams */
+  double tokens_; /* may go negative when datagrams are scheduled ahead */
+  uint64_t last_update_ns_;
+
+  /* add the tokens earned since the last update */
+  void refill( const uint64_t now_ns );
+
+public:
+  Pacer( const double burst );
+
+  /* set the pacing rate, in datagrams per second */
+  void set_rate( const double rate, const uint64_t now_ns );
+
+  /* earliest time (monotonic nanoseconds) the next datagram may leave */
+  uint64_t departure_time( const uint64_t now_ns );
+
+  /* a datagram was released */
+  void datagram_sent( const uint64_t now_ns );
+};
+
+#endif
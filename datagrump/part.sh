@@ -23,4 +23,59 @@ elif [ "$1" = "dprime" ]; then
   cp sender_sarsa.cc sender.cc
   cp controller_sarsa.cc controller.cc 
   cp controller_sarsa.hh controller.hh
+elif [ "$1" = "bbr" ]; then
+  echo "Using BBR"
+  cp sender_bbr.cc sender.cc
+  cp controller_bbr.cc controller.cc 
+  cp controller_bbr.hh controller.hh
+elif [ "$1" = "sprout" ]; then
+  echo "Using Sprout"
+  cp sender_sprout.cc sender.cc
+  cp controller_sprout.cc controller.cc 
+  cp controller_sprout.hh controller.hh
+elif [ "$1" = "copa" ]; then
+  echo "Using Copa"
+  cp sender_copa.cc sender.cc
+  cp controller_copa.cc controller.cc 
+  cp controller_copa.hh controller.hh
+elif [ "$1" = "gradient" ]; then
+  echo "Using delay gradient"
+  cp sender_gradient.cc sender.cc
+  cp controller_gradient.cc controller.cc 
+  cp controller_gradient.hh controller.hh
+elif [ "$1" = "vivace" ]; then
+  echo "Using PCC Vivace"
+  cp sender_vivace.cc sender.cc
+  cp controller_vivace.cc controller.cc 
+  cp controller_vivace.hh controller.hh
+elif [ "$1" = "remy" ]; then
+  echo "Using Remy"
+  cp sender_remy.cc sender.cc
+  cp controller_remy.cc controller.cc 
+  cp controller_remy.hh controller.hh
+elif [ "$1" = "aurora" ]; then
+  echo "Using Aurora"
+  cp sender_aurora.cc sender.cc
+  cp controller_aurora.cc controller.cc 
+  cp controller_aurora.hh controller.hh
+elif [ "$1" = "cubic" ]; then
+  echo "Using CUBIC"
+  cp sender_cubic.cc sender.cc
+  cp controller_cubic.cc controller.cc 
+  cp controller_cubic.hh controller.hh
+elif [ "$1" = "ledbat" ]; then
+  echo "Using LEDBAT"
+  cp sender_ledbat.cc sender.cc
+  cp controller_ledbat.cc controller.cc 
+  cp controller_ledbat.hh controller.hh
+elif [ "$1" = "dctcp" ]; then
+  echo "Using DCTCP"
+  cp sender_dctcp.cc sender.cc
+  cp controller_dctcp.cc controller.cc 
+  cp controller_dctcp.hh controller.hh
+elif [ "$1" = "meta" ]; then
+  echo "Using the meta-controller"
+  cp sender_meta.cc sender.cc
+  cp controller_meta.cc controller.cc 
+  cp controller_meta.hh controller.hh
 fi
@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "rate_sampler.hh"
+
+using namespace std;
+
+/* how long a minimum RTT sample stays current (milliseconds) */
+static const uint64_t MIN_RTT_WINDOW = 10000;
+
+RateSampler::RateSampler()
+  : flight_(),
+    delivered_( 0 ),
+    delivered_time_( 0 ),
+    first_sent_time_( 0 ),
+    min_rtt_( MIN_RTT_WINDOW )
+{}
+
+/* A datagram was sent, with in_flight datagrams already outstanding */
+void RateSampler::sent( const uint64_t sequence_number,
+			const uint64_t send_time,
+			const uint64_t in_flight )
+{
+  /* a flight that starts from idle starts the clocks afresh */
+  if ( in_flight == 0 ) {
+    first_sent_time_ = delivered_time_ = send_time;
+  }
+
+  flight_.sent( sequence_number, send_time,
+		DeliveryState { delivered_, delivered_time_, first_sent_time_ } );
+}
+
+/* A datagram was acked; returns whether it gave a valid sample */
+bool RateSampler::acked( const uint64_t sequence_number,
+			 const uint64_t now,
+			 RateSample & sample )
+{
+  const auto * const record = flight_.find( sequence_number );
+  if ( not record ) {
+    return false;
+  }
+
+  const uint64_t send_time = record->send_timestamp;
+  const DeliveryState datagram = record->info;
+  flight_.acked( sequence_number );
+
+  delivered_++;
+  delivered_time_ = now;
+
+  /* the next sample's send phase starts where this one's ended (unless
+     this is a reordered ack for a datagram sent before the last one) */
+  if ( send_time >= first_sent_time_ ) {
+    first_sent_time_ = send_time;
+  }
+
+  const uint64_t rtt = now - send_time;
+  min_rtt_.update( rtt, now );
+
+  /* ack compression can shrink the ack phase, so use the longer phase */
+  const uint64_t send_elapsed = send_time - datagram.first_sent_time;
+  const uint64_t ack_elapsed = now - datagram.delivered_time;
+
+  sample.prior_delivered = datagram.delivered;
+  sample.delivered = delivered_ - datagram.delivered;
+  sample.interval = max( send_elapsed, ack_elapsed );
+  sample.rtt = rtt;
+
+  /* a sample over less than a round trip is too short to trust */
+  if ( sample.interval == 0 or sample.interval < min_rtt_.get() ) {
+    sample.delivery_rate = 0;
+    return false;
+  }
+
+  sample.delivery_rate = sample.delivered * 1000.0 / sample.interval;
+  return true;
+}
+
+/* A datagram was declared lost (it gives no sample) */
+void RateSampler::lost( const uint64_t sequence_number )
+{
+  flight_.lost( sequence_number );
+}
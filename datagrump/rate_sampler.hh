@@ -0,0 +1,66 @@
+#ifndef RATE_SAMPLER_HH
+#define RATE_SAMPLER_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#include "estimators.hh"
+#include "outstanding_packets.hh"
+
+/* A delivery-rate sample, taken when a datagram is acked */
+struct RateSample {
+  double delivery_rate;     /* datagrams per second */
+  uint64_t prior_delivered; /* delivered count when the acked datagram was sent */
+  uint64_t delivered;       /* datagrams delivered over the interval */
+  uint64_t interval;        /* milliseconds */
+  uint64_t rtt;             /* of the acked datagram, in milliseconds */
+};
+
+/* Per-datagram delivery-rate sampling, after Linux's tcp_rate.c. Each
+   datagram records how much had been delivered, and when, as it left;
+   its ack then gives the delivery rate over the datagram's flight. The
+   interval is the longer of the send and ack phases, so a burst of
+   compressed or aggregated acks can't inflate the rate, and samples
+   over less than the minimum RTT are discarded. The sender always has
+   data to send, so unlike tcp_rate.c there is no app-limited state: a
+   sample only understates the path when the window does. Times are in
+   milliseconds. */
+class RateSampler
+{
+private:
+  /* what each outstanding datagram remembers of the moment it left */
+  struct DeliveryState {
+    uint64_t delivered;       /* delivered count when sent */
+    uint64_t delivered_time;  /* when that count was reached */
+    uint64_t first_sent_time; /* send time of the datagram that began the flight */
+  };
+
+  OutstandingRing<DeliveryState> flight_;
+
+  uint64_t delivered_;
+  uint64_t delivered_time_;
+  uint64_t first_sent_time_;
+
+  WindowedMinFilter min_rtt_;
+
+public:
+  RateSampler();
+
+  /* A datagram was sent, with in_flight datagrams already outstanding */
+  void sent( const uint64_t sequence_number,
+	     const uint64_t send_time,
+	     const uint64_t in_flight );
+
+  /* A datagram was acked; returns whether it gave a valid sample */
+  bool acked( const uint64_t sequence_number,
+	      const uint64_t now,
+	      RateSample & sample );
+
+  /* A datagram was declared lost (it gives no sample) */
+  void lost( const uint64_t sequence_number );
+
+  /* Datagrams delivered so far */
+  uint64_t delivered( void ) const { return delivered_; }
+};
+
+#endif
@@ -2,11 +2,161 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <list>
+#include <map>
 
 #include "socket.hh"
 #include "contest_message.hh"
+#include "poller.hh"
+#include "timestamp.hh"
 
 using namespace std;
+using namespace PollerShortNames;
+
+/* most peers that get their own connected socket at once; once they
+   are all taken, a new peer gets the socket of a peer that has been
+   idle this long (ms), or else is acknowledged with sendto() on the
+   listening socket */
+static const size_t MAX_CONNECTED_PEERS = 1024;
+static const uint64_t PEER_IDLE_TIMEOUT = 10000;
+
+/* turn an incoming datagram into its acknowledgment */
+static string make_ack( const UDPSocket::received_datagram & recd,
+			uint64_t & sequence_number )
+{
+  ContestMessage message = recd.payload;
+
+  /* assemble the acknowledgment */
+  message.transform_into_ack( sequence_number++, recd.timestamp, recd.ecn );
+
+  /* acks use the same header format as the datagram; a sender still
+     using the legacy format learns that it can switch to compact */
+  if ( message.header.format == ContestMessage::Format::Legacy ) {
+    message.offer_compact();
+  }
+
+  /* timestamp the ack just before sending */
+  message.set_send_timestamp();
+
+  return message.to_string();
+}
+
+/* acknowledge each peer through a socket connected to it (sharing the
+   listening port with SO_REUSEPORT), so acks go out with send() on a
+   cached route instead of sendto() with the peer's address */
+static int connected_loop( UDPSocket & socket )
+{
+  uint64_t sequence_number = 0;
+
+  /* the per-peer sockets share the port the peers actually reached
+     (which differs from the one asked for if that was 0) */
+  const Address local_address = socket.local_address();
+
+  struct PeerSocket {
+    UDPSocket socket;
+    string peer;
+    uint64_t last_datagram; /* when the peer last sent, in milliseconds */
+  };
+
+  /* per-peer sockets, keyed by the peer's address */
+  list<PeerSocket> peer_sockets;
+  map<string, PeerSocket *> socket_for_peer;
+
+  /* new sockets are added to the poller after the current poll()
+     returns, since the poller can't grow while running callbacks */
+  list<PeerSocket *> new_peer_sockets;
+
+  Poller poller;
+
+  /* once connected, the kernel delivers a peer's datagrams to its own socket */
+  const auto add_peer_action = [&] ( PeerSocket & peer_socket ) {
+    poller.add_action( Action( peer_socket.socket, Direction::In, [&] () {
+	  const UDPSocket::received_datagram recd = peer_socket.socket.recv();
+	  peer_socket.last_datagram = timestamp_ms();
+	  peer_socket.socket.send( make_ack( recd, sequence_number ) );
+	  return ResultType::Continue;
+	} ) );
+  };
+
+  /* the socket of the longest-idle peer, if it has been idle long enough
+     to give to another (the poller can't drop a socket, so idle ones
+     are reconnected rather than closed) */
+  const auto idle_peer_socket = [&] () -> PeerSocket * {
+    PeerSocket * idlest = nullptr;
+    for ( PeerSocket & peer_socket : peer_sockets ) {
+      if ( not idlest or peer_socket.last_datagram < idlest->last_datagram ) {
+	idlest = &peer_socket;
+      }
+    }
+
+    if ( idlest and timestamp_ms() - idlest->last_datagram >= PEER_IDLE_TIMEOUT ) {
+      return idlest;
+    }
+    return nullptr;
+  };
+
+  /* the listening socket sees the first datagrams from each peer */
+  poller.add_action( Action( socket, Direction::In, [&] () {
+	const UDPSocket::received_datagram recd = socket.recv();
+	const string peer = recd.source_address.to_string();
+
+	auto it = socket_for_peer.find( peer );
+	if ( it == socket_for_peer.end()
+	     and socket_for_peer.size() < MAX_CONNECTED_PEERS ) {
+	  peer_sockets.push_back( PeerSocket { UDPSocket(), peer, timestamp_ms() } );
+	  PeerSocket & peer_socket = peer_sockets.back();
+	  peer_socket.socket.set_timestamps();
+	  peer_socket.socket.set_receive_ecn();
+	  peer_socket.socket.set_reuseport();
+	  peer_socket.socket.bind( local_address );
+	  peer_socket.socket.connect( recd.source_address );
+
+	  it = socket_for_peer.emplace( peer, &peer_socket ).first;
+	  new_peer_sockets.push_back( &peer_socket );
+	} else if ( it == socket_for_peer.end() ) {
+	  PeerSocket * const idle = idle_peer_socket();
+	  if ( idle ) {
+	    /* a connected UDP socket can be connected again, to another peer */
+	    socket_for_peer.erase( idle->peer );
+	    idle->socket.connect( recd.source_address );
+	    idle->peer = peer;
+	    idle->last_datagram = timestamp_ms();
+	    it = socket_for_peer.emplace( peer, idle ).first;
+	  }
+	}
+
+	if ( it == socket_for_peer.end() ) {
+	  socket.sendto( recd.source_address, make_ack( recd, sequence_number ) );
+	} else {
+	  it->second->socket.send( make_ack( recd, sequence_number ) );
+	}
+
+	return ResultType::Continue;
+      } ) );
+
+  while ( true ) {
+    const auto ret = poller.poll( -1 );
+    if ( ret.result == PollResult::Exit ) {
+      /* a peer that went away makes its connected socket report an
+	 error (ICMP port unreachable); clear it and keep going */
+      bool peer_error = false;
+      for ( PeerSocket & peer_socket : peer_sockets ) {
+	if ( peer_socket.socket.pending_error() ) {
+	  peer_error = true;
+	}
+      }
+
+      if ( not peer_error ) {
+	return ret.exit_status;
+      }
+    }
+
+    for ( PeerSocket * const peer_socket : new_peer_sockets ) {
+      add_peer_action( *peer_socket );
+    }
+    new_peer_sockets.clear();
+  }
+}
 
 int main( int argc, char *argv[] )
 {
@@ -15,8 +165,13 @@ int main( int argc, char *argv[] )
     abort();
   }
 
-  if ( argc != 2 ) {
-    cerr << "Usage: " << argv[ 0 ] << " PORT" << endl;
+  bool connected = false;
+  if ( argc == 3 and string( argv[ 2 ] ) == "connected" ) {
+    connected = true;
+  } else if ( argc == 2 ) {
+    /* do nothing */
+  } else {
+    cerr << "Usage: " << argv[ 0 ] << " PORT [connected]" << endl;
     return EXIT_FAILURE;
   }
 
@@ -26,26 +181,32 @@ int main( int argc, char *argv[] )
   /* turn on timestamps on receipt */
   socket.set_timestamps();
 
+  /* see the ECN bits of incoming datagrams, to echo them */
+  socket.set_receive_ecn();
+
+  /* per-peer sockets will share the port */
+  if ( connected ) {
+    socket.set_reuseport();
+  }
+
   /* "bind" the socket to the user-specified local port number */
-  socket.bind( Address( "::0", argv[ 1 ] ) );
+  const Address local_address( "::0", argv[ 1 ] );
+  socket.bind( local_address );
 
   cerr << "Listening on " << socket.local_address().to_string() << endl;
 
+  if ( connected ) {
+    return connected_loop( socket );
+  }
+
   uint64_t sequence_number = 0;
 
   /* Loop and acknowledge every incoming datagram back to its source */
   while ( true ) {
     const UDPSocket::received_datagram recd = socket.recv();
-    ContestMessage message = recd.payload;
-
-    /* assemble the acknowledgment */
-    message.transform_into_ack( sequence_number++, recd.timestamp );
-
-    /* timestamp the ack just before sending */
-    message.set_send_timestamp();
 
     /* send the ack */
-    socket.sendto( recd.source_address, message.to_string() );
+    socket.sendto( recd.source_address, make_ack( recd, sequence_number ) );
   }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <cmath>
+
+#include "rtt_estimator.hh"
+
+using namespace std;
+
+/* gains for the smoothed RTT and the RTT variation (RFC 6298) */
+static const double ALPHA = 0.125;
+static const double BETA = 0.25;
+
+/* RTO = SRTT + max(G, K * RTTVAR), with G the clock granularity */
+static const double K = 4;
+static const double CLOCK_GRANULARITY = 1;
+
+/* the backoff stops doubling past this (the RTO is clamped anyway) */
+static const unsigned int MAX_BACKOFF = 16;
+
+RttEstimator::RttEstimator( const unsigned int initial_rto,
+			    const unsigned int min_rto,
+			    const unsigned int max_rto,
+			    const uint64_t min_rtt_window )
+  : initial_rto_( initial_rto ),
+    min_rto_( min_rto ),
+    max_rto_( max_rto ),
+    srtt_( ALPHA ),
+    rttvar_( BETA ),
+    min_rtt_( min_rtt_window ),
+    backoff_( 0 )
+{}
+
+/* A new RTT sample, measured at time now */
+void RttEstimator::sample( const uint64_t rtt, const uint64_t now )
+{
+  /* the variation is updated with the previous smoothed RTT */
+  rttvar_.update( srtt_.has_value() ? abs( srtt_.get() - rtt ) : rtt / 2.0 );
+  srtt_.update( rtt );
+
+  min_rtt_.update( rtt, now );
+
+  backoff_ = 0;
+}
+
+/* The retransmission timeout expired: double the RTO until the next sample */
+void RttEstimator::timed_out( void )
+{
+  backoff_ = min( backoff_ + 1, MAX_BACKOFF );
+}
+
+/* Retransmission timeout, with backoff */
+unsigned int RttEstimator::rto( void ) const
+{
+  const double base = not has_sample() ? initial_rto_
+    : srtt_.get() + max( CLOCK_GRANULARITY, K * rttvar_.get() );
+
+  const double rto = max( double( min_rto_ ), base ) * (uint64_t( 1 ) << backoff_);
+
+  return min( double( max_rto_ ), rto );
+}
@@ -0,0 +1,55 @@
+#ifndef RTT_ESTIMATOR_HH
+#define RTT_ESTIMATOR_HH
+
+#include <cstdint>
+
+#include "estimators.hh"
+
+/* Round-trip time estimator shared by the controllers: smoothed RTT
+   and RTT variation (as in RFC 6298), the minimum RTT over a sliding
+   window, and a retransmission timeout that backs off exponentially
+   and stays within bounds. Times are in milliseconds. */
+class RttEstimator
+{
+private:
+  unsigned int initial_rto_; /* until the first sample */
+  unsigned int min_rto_;
+  unsigned int max_rto_;
+
+  Ewma srtt_;
+  Ewma rttvar_;
+  WindowedMinFilter min_rtt_;
+
+  unsigned int backoff_; /* timeouts since the last sample */
+
+public:
+  RttEstimator( const unsigned int initial_rto,
+		const unsigned int min_rto,
+		const unsigned int max_rto,
+		const uint64_t min_rtt_window );
+
+  /* A new RTT sample, measured at time now */
+  void sample( const uint64_t rtt, const uint64_t now );
+
+  /* The retransmission timeout expired: double the RTO until the next sample */
+  void timed_out( void );
+
+  bool has_sample( void ) const { return srtt_.has_value(); }
+
+  /* Smoothed RTT (-1 until the first sample) */
+  double srtt( void ) const { return has_sample() ? srtt_.get() : -1; }
+
+  /* RTT variation */
+  double rttvar( void ) const { return rttvar_.get(); }
+
+  /* Minimum RTT seen over the window (-1 until the first sample) */
+  uint64_t min_rtt( void ) const
+  {
+    return has_sample() ? uint64_t( min_rtt_.get() ) : uint64_t( -1 );
+  }
+
+  /* Retransmission timeout, with backoff */
+  unsigned int rto( void ) const;
+};
+
+#endif
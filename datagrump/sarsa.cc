@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined( __GNUC__ ) and ( defined( __x86_64__ ) or defined( __i386__ ) )
+#define SARSA_X86 1
+#include <immintrin.h>
+#endif
+
+#include "sarsa.hh"
+#include "file_descriptor.hh"
+#include "util.hh"
+
+#define LANES 8 /* floats per AVX2 vector; weight rows are padded to this */
+#define ALIGNMENT 32 /* bytes, for aligned AVX2 loads of the rows */
+#define MAX_TILES (1 << 24) /* per tiling */
+#define MIN_TRACE 0.01 /* smaller traces are dropped */
+#define TABLE_MAGIC "SARSAQT" /* with its NUL, 8 bytes */
+#define TABLE_VERSION 1
+#define TABLE_ALIGNMENT 64 /* bytes; the weights start at a multiple of this */
+
+using namespace std;
+
+TileCoder::TileCoder( const vector<Dimension> & dimensions,
+		      const size_t tilings, const size_t tiles )
+  : dimensions_( dimensions ),
+    tilings_( tilings ),
+    tiles_( tiles ),
+    tiles_per_tiling_( 1 )
+{
+  if ( dimensions_.empty() or tilings_ == 0 or tiles_ == 0 ) {
+    throw runtime_error( "tile coder: needs at least one dimension, tiling and tile" );
+  }
+
+  for ( const Dimension & dimension : dimensions_ ) {
+    if ( not ( dimension.low < dimension.high ) ) {
+      throw runtime_error( "tile coder: empty feature range" );
+    }
+    tiles_per_tiling_ *= tiles_ + 1;
+    if ( tiles_per_tiling_ > MAX_TILES ) {
+      throw runtime_error( "tile coder: too many tiles" );
+    }
+  }
+}
+
+void TileCoder::encode( const vector<double> & features, vector<uint32_t> & active ) const
+{
+  if ( features.size() != dimensions_.size() ) {
+    throw runtime_error( "tile coder: wrong number of features" );
+  }
+
+  active.resize( tilings_ );
+  for ( size_t tiling = 0; tiling < tilings_; tiling++ ) {
+    size_t index = tiling * tiles_per_tiling_;
+    size_t stride = 1;
+
+    for ( size_t dimension = 0; dimension < dimensions_.size(); dimension++ ) {
+      const Dimension & range = dimensions_[ dimension ];
+      double scaled = (features[ dimension ] - range.low) / (range.high - range.low) * tiles_;
+      scaled = scaled >= 0 ? min( scaled, tiles_ - 1e-6 ) : 0; /* (NaN lands at 0) */
+
+      /* tiling t is shifted by (2d + 1) t / tilings of a tile in dimension d */
+      const double offset = fmod( double( (2 * dimension + 1) * tiling ) / tilings_, 1.0 );
+      index += size_t( scaled + offset ) * stride;
+      stride *= tiles_ + 1;
+    }
+
+    active[ tiling ] = index;
+  }
+}
+
+/* Q values: out[ a ] = sum of the active rows' a-th weights */
+static void sum_rows_scalar( const float * weights, const vector<uint32_t> & active,
+			     const size_t stride, float * out )
+{
+  fill( out, out + stride, 0 );
+  for ( const uint32_t tile : active ) {
+    const float * row = weights + size_t( tile ) * stride;
+    for ( size_t lane = 0; lane < stride; lane++ ) {
+      out[ lane ] += row[ lane ];
+    }
+  }
+}
+
+/* The first action with the largest Q value */
+static size_t argmax_scalar( const float * q_values, const size_t actions )
+{
+  return max_element( q_values, q_values + actions ) - q_values;
+}
+
+#ifdef SARSA_X86
+__attribute__(( target( "avx2" ) ))
+static void sum_rows_avx2( const float * weights, const vector<uint32_t> & active,
+			   const size_t stride, float * out )
+{
+  for ( size_t lane = 0; lane < stride; lane += LANES ) {
+    __m256 sum = _mm256_setzero_ps();
+    for ( const uint32_t tile : active ) {
+      sum = _mm256_add_ps( sum, _mm256_load_ps( weights + size_t( tile ) * stride + lane ) );
+    }
+    _mm256_storeu_ps( out + lane, sum );
+  }
+}
+
+/* (the padding lanes must hold -infinity) */
+__attribute__(( target( "avx2" ) ))
+static size_t argmax_avx2( const float * q_values, const size_t stride )
+{
+  __m256 top = _mm256_loadu_ps( q_values );
+  for ( size_t lane = LANES; lane < stride; lane += LANES ) {
+    top = _mm256_max_ps( top, _mm256_loadu_ps( q_values + lane ) );
+  }
+
+  __m128 half = _mm_max_ps( _mm256_castps256_ps128( top ), _mm256_extractf128_ps( top, 1 ) );
+  half = _mm_max_ps( half, _mm_movehl_ps( half, half ) );
+  half = _mm_max_ss( half, _mm_shuffle_ps( half, half, 1 ) );
+  const __m256 best = _mm256_set1_ps( _mm_cvtss_f32( half ) );
+
+  for ( size_t lane = 0; lane < stride; lane += LANES ) {
+    const int matches = _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( q_values + lane ),
+							    best, _CMP_EQ_OQ ) );
+    if ( matches ) {
+      return lane + __builtin_ctz( matches );
+    }
+  }
+
+  return 0; /* (all NaN) */
+}
+#endif
+
+static SarsaLambda::Kernel best_kernel( void )
+{
+#ifdef SARSA_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return SarsaLambda::Kernel::Avx2;
+  }
+#endif
+  return SarsaLambda::Kernel::Scalar;
+}
+
+static float * aligned_weights( const size_t count )
+{
+  void * weights = nullptr;
+  if ( posix_memalign( &weights, ALIGNMENT, count * sizeof( float ) ) ) {
+    throw runtime_error( "sarsa: cannot allocate the weights" );
+  }
+
+  fill( static_cast<float *>( weights ), static_cast<float *>( weights ) + count, 0 );
+  return static_cast<float *>( weights );
+}
+
+SarsaLambda::SarsaLambda( const TileCoder & coder, const size_t actions,
+			  const double alpha, const double epsilon,
+			  const double gamma, const double lambda,
+			  const uint64_t seed )
+  : coder_( coder ),
+    actions_( actions ),
+    stride_( (actions + LANES - 1) / LANES * LANES ),
+    weights_( aligned_weights( coder.size() * stride_ ), free ),
+    alpha_( alpha ),
+    epsilon_( epsilon ),
+    gamma_( gamma ),
+    lambda_( lambda ),
+    kernel_( best_kernel() ),
+    random_( seed ),
+    traces_(),
+    active_(),
+    action_( 0 ),
+    q_( 0 ),
+    has_action_( false ),
+    next_active_(),
+    q_values_( stride_, 0 )
+{
+  if ( actions_ == 0 ) {
+    throw runtime_error( "sarsa: no actions" );
+  }
+  if ( coder_.size() * stride_ > numeric_limits<uint32_t>::max() ) {
+    throw runtime_error( "sarsa: too many weights" );
+  }
+}
+
+/* Fill q_values_ for a state, with -infinity in the padding lanes */
+void SarsaLambda::evaluate( const vector<uint32_t> & active )
+{
+  switch ( kernel_ ) {
+#ifdef SARSA_X86
+  case Kernel::Avx2:
+    sum_rows_avx2( weights_.get(), active, stride_, q_values_.data() );
+    break;
+#endif
+  default:
+    sum_rows_scalar( weights_.get(), active, stride_, q_values_.data() );
+  }
+
+  fill( q_values_.begin() + actions_, q_values_.end(), -numeric_limits<float>::infinity() );
+}
+
+size_t SarsaLambda::best_action( void ) const
+{
+#ifdef SARSA_X86
+  if ( kernel_ == Kernel::Avx2 ) {
+    return argmax_avx2( q_values_.data(), stride_ );
+  }
+#endif
+  return argmax_scalar( q_values_.data(), actions_ );
+}
+
+/* Set (replacing) traces on the weights of a state's tiles for an action */
+void SarsaLambda::trace( const vector<uint32_t> & active, const size_t action )
+{
+  for ( const uint32_t tile : active ) {
+    const uint32_t weight = tile * stride_ + action;
+    auto existing = find_if( traces_.begin(), traces_.end(),
+			     [&]( const Trace & each ) { return each.weight == weight; } );
+    if ( existing == traces_.end() ) {
+      traces_.push_back( Trace { weight, 1 } );
+    } else {
+      existing->value = 1;
+    }
+  }
+}
+
+size_t SarsaLambda::step( const double reward, const vector<double> & features )
+{
+  coder_.encode( features, next_active_ );
+  evaluate( next_active_ );
+
+  const size_t next_action = random_.uniform() < epsilon_
+    ? random_.below( actions_ ) : best_action();
+
+  if ( has_action_ ) {
+    const double delta = reward + gamma_ * q_values_[ next_action ] - q_;
+    const float change = alpha_ / coder_.tilings() * delta;
+    const float decay = gamma_ * lambda_;
+
+    float * weights = weights_.get();
+    for ( Trace & each : traces_ ) {
+      weights[ each.weight ] += change * each.value;
+      each.value *= decay;
+    }
+    traces_.erase( remove_if( traces_.begin(), traces_.end(),
+			      []( const Trace & each ) { return each.value < MIN_TRACE; } ),
+		   traces_.end() );
+
+    /* (the update may have moved the next state's values too) */
+    evaluate( next_active_ );
+  }
+
+  active_.swap( next_active_ );
+  action_ = next_action;
+  q_ = q_values_[ next_action ];
+  has_action_ = true;
+  trace( active_, action_ );
+
+  return next_action;
+}
+
+void SarsaLambda::reset( void )
+{
+  has_action_ = false;
+  traces_.clear();
+}
+
+void SarsaLambda::prefer_action( const vector<double> & features,
+				 const size_t action, const double value )
+{
+  if ( action >= actions_ ) {
+    throw runtime_error( "sarsa: no such action" );
+  }
+
+  vector<uint32_t> active;
+  coder_.encode( features, active );
+  for ( const uint32_t tile : active ) {
+    float * row = weights_.get() + size_t( tile ) * stride_;
+    fill( row, row + actions_, 0 );
+    row[ action ] = value / coder_.tilings();
+  }
+}
+
+/* The fixed part of a table file (see sarsa.hh) */
+struct TableHeader {
+  char magic[ 8 ];
+  uint32_t version;
+  uint32_t dimensions, tilings, tiles, actions, stride;
+  uint64_t weights;
+  uint64_t checksum;
+};
+
+/* 64-bit FNV-1a */
+static uint64_t fnv1a( const char * data, const size_t length )
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for ( size_t i = 0; i < length; i++ ) {
+    hash = (hash ^ uint8_t( data[ i ] )) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* A file mapped into memory for as long as this lives */
+class MappedFile
+{
+private:
+  char * data_;
+  size_t length_;
+
+public:
+  MappedFile( const FileDescriptor & file, const size_t length, const int protection )
+    : data_( nullptr ), length_( length )
+  {
+    void * data = mmap( nullptr, length, protection, MAP_SHARED, file.fd_num(), 0 );
+    if ( data == MAP_FAILED ) {
+      throw unix_error( "mmap" );
+    }
+    data_ = static_cast<char *>( data );
+  }
+
+  ~MappedFile() { munmap( data_, length_ ); }
+
+  char * data( void ) const { return data_; }
+
+  MappedFile( const MappedFile & other ) = delete;
+  const MappedFile & operator=( const MappedFile & other ) = delete;
+};
+
+static size_t table_weights_offset( const size_t dimensions )
+{
+  const size_t end = sizeof( TableHeader ) + dimensions * 2 * sizeof( double );
+  return (end + TABLE_ALIGNMENT - 1) / TABLE_ALIGNMENT * TABLE_ALIGNMENT;
+}
+
+void SarsaLambda::snapshot( vector<float> & weights ) const
+{
+  weights.assign( weights_.get(), weights_.get() + coder_.size() * stride_ );
+}
+
+void SarsaLambda::save( const string & path ) const
+{
+  vector<float> weights;
+  snapshot( weights );
+  save( path, weights );
+}
+
+void SarsaLambda::save( const string & path, const vector<float> & weights ) const
+{
+  const size_t offset = table_weights_offset( coder_.dimensions() );
+  const size_t weight_count = coder_.size() * stride_;
+  if ( weights.size() != weight_count ) {
+    throw runtime_error( "sarsa: saving weights of another shape" );
+  }
+
+  const size_t length = offset + weight_count * sizeof( float );
+  const string temporary = path + ".tmp";
+
+  {
+    FileDescriptor file( SystemCall( "open " + temporary,
+				     open( temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) ) );
+    SystemCall( "ftruncate " + temporary, ftruncate( file.fd_num(), length ) );
+    MappedFile table( file, length, PROT_READ | PROT_WRITE );
+
+    double * ranges = reinterpret_cast<double *>( table.data() + sizeof( TableHeader ) );
+    for ( const TileCoder::Dimension & range : coder_.ranges() ) {
+      *ranges++ = range.low;
+      *ranges++ = range.high;
+    }
+    memcpy( table.data() + offset, weights.data(), weight_count * sizeof( float ) );
+
+    TableHeader header;
+    memcpy( header.magic, TABLE_MAGIC, sizeof( header.magic ) );
+    header.version = TABLE_VERSION;
+    header.dimensions = coder_.dimensions();
+    header.tilings = coder_.tilings();
+    header.tiles = coder_.tiles();
+    header.actions = actions_;
+    header.stride = stride_;
+    header.weights = weight_count;
+    header.checksum = fnv1a( table.data() + sizeof( TableHeader ),
+			     length - sizeof( TableHeader ) );
+    memcpy( table.data(), &header, sizeof( header ) );
+  }
+
+  SystemCall( "rename " + temporary, rename( temporary.c_str(), path.c_str() ) );
+}
+
+bool SarsaLambda::load( const string & path )
+{
+  const int fd = open( path.c_str(), O_RDONLY );
+  if ( fd < 0 and errno == ENOENT ) {
+    return false;
+  }
+  FileDescriptor file( SystemCall( "open " + path, fd ) );
+
+  struct stat status;
+  SystemCall( "fstat " + path, fstat( file.fd_num(), &status ) );
+  const size_t length = status.st_size;
+  if ( length < sizeof( TableHeader ) ) {
+    throw runtime_error( "sarsa: " + path + " is truncated" );
+  }
+
+  MappedFile table( file, length, PROT_READ );
+  TableHeader header;
+  memcpy( &header, table.data(), sizeof( header ) );
+
+  if ( memcmp( header.magic, TABLE_MAGIC, sizeof( header.magic ) ) ) {
+    throw runtime_error( "sarsa: " + path + " is not a table (bad magic)" );
+  }
+  if ( header.version != TABLE_VERSION ) {
+    throw runtime_error( "sarsa: " + path + " is table version " + to_string( header.version )
+			 + ", not " + to_string( TABLE_VERSION ) );
+  }
+
+  const size_t offset = table_weights_offset( coder_.dimensions() );
+  const size_t weight_count = coder_.size() * stride_;
+  if ( header.dimensions != coder_.dimensions() or header.tilings != coder_.tilings()
+       or header.tiles != coder_.tiles() or header.actions != actions_
+       or header.stride != stride_ or header.weights != weight_count ) {
+    throw runtime_error( "sarsa: " + path + " is a table of another shape" );
+  }
+  if ( length != offset + weight_count * sizeof( float ) ) {
+    throw runtime_error( "sarsa: " + path + " has the wrong length" );
+  }
+  if ( header.checksum != fnv1a( table.data() + sizeof( TableHeader ),
+				 length - sizeof( TableHeader ) ) ) {
+    throw runtime_error( "sarsa: " + path + " is corrupt (bad checksum)" );
+  }
+
+  const double * ranges = reinterpret_cast<const double *>( table.data() + sizeof( TableHeader ) );
+  for ( const TileCoder::Dimension & range : coder_.ranges() ) {
+    if ( *ranges++ != range.low or *ranges++ != range.high ) {
+      throw runtime_error( "sarsa: " + path + " codes features over other ranges" );
+    }
+  }
+
+  memcpy( weights_.get(), table.data() + offset, weight_count * sizeof( float ) );
+  reset();
+  return true;
+}
+
+TableSaver::TableSaver( const SarsaLambda & engine, const string & path )
+  : engine_( engine ),
+    path_( path ),
+    mutex_(),
+    wake_(),
+    pending_(),
+    has_pending_( false ),
+    stopping_( false ),
+    thread_()
+{
+  thread_ = thread( [this] () { run(); } );
+}
+
+TableSaver::~TableSaver()
+{
+  {
+    lock_guard<mutex> lock( mutex_ );
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void TableSaver::save( void )
+{
+  {
+    lock_guard<mutex> lock( mutex_ );
+    engine_.snapshot( pending_ );
+    has_pending_ = true;
+  }
+  wake_.notify_one();
+}
+
+void TableSaver::run( void )
+{
+  vector<float> weights;
+
+  while ( true ) {
+    {
+      unique_lock<mutex> lock( mutex_ );
+      wake_.wait( lock, [this] () { return has_pending_ or stopping_; } );
+      if ( not has_pending_ ) {
+	return;
+      }
+      weights.swap( pending_ );
+      has_pending_ = false;
+    }
+
+    /* a failed save loses one copy, not the sender */
+    try {
+      engine_.save( path_, weights );
+    } catch ( const exception & e ) {
+      cerr << "sarsa: saving " << path_ << " failed: " << e.what() << endl;
+    }
+  }
+}
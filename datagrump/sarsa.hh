@@ -0,0 +1,207 @@
+#ifndef SARSA_HH
+#define SARSA_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* xorshift64* (Vigna): a few shifts and a multiply per number, for
+   exploration decisions on the ack path */
+class XorShift
+{
+private:
+  uint64_t state_;
+
+public:
+  XorShift( const uint64_t seed ) : state_( seed ? seed : 0x9e3779b97f4a7c15ULL ) {}
+
+  uint64_t next( void )
+  {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545f4914f6cdd1dULL;
+  }
+
+  /* Uniform in [0, 1) */
+  double uniform( void ) { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  /* Uniform in [0, n) */
+  size_t below( const size_t n ) { return uniform() * n; }
+};
+
+/* Tile coding of continuous features. Each feature's range is cut into
+   tiles; each of several tilings is offset from the others by a
+   fraction of a tile (by a different fraction in each dimension, so
+   the tilings don't line up along the diagonal), and a point is coded
+   as the one tile it falls in per tiling. Features outside their range
+   count as at its edge. */
+class TileCoder
+{
+public:
+  struct Dimension {
+    double low, high;
+  };
+
+private:
+  std::vector<Dimension> dimensions_;
+  size_t tilings_;
+  size_t tiles_;            /* per dimension */
+  size_t tiles_per_tiling_; /* (tiles + 1) ^ dimensions: offsets reach one tile further */
+
+public:
+  TileCoder( const std::vector<Dimension> & dimensions,
+	     const size_t tilings, const size_t tiles );
+
+  /* The active tile of each tiling, one per tiling */
+  void encode( const std::vector<double> & features,
+	       std::vector<uint32_t> & active ) const;
+
+  const std::vector<Dimension> & ranges( void ) const { return dimensions_; }
+  size_t dimensions( void ) const { return dimensions_.size(); }
+  size_t tilings( void ) const { return tilings_; }
+  size_t tiles( void ) const { return tiles_; }
+
+  /* Tiles over all tilings */
+  size_t size( void ) const { return tilings_ * tiles_per_tiling_; }
+};
+
+/* Sarsa(lambda) over tile-coded states and a small set of discrete
+   actions, with a linear Q function: Q(s, a) is the sum of the weights
+   of s's active tiles for a. The weights are one 32-byte-aligned array
+   with a row per tile and the actions padded to a multiple of 8
+   floats, so the Q values of every action come from adding up a few
+   rows in whole AVX2 vectors (the kernel is picked once, from what the
+   CPU supports, with a scalar fallback). Eligibility traces are
+   replacing and kept as a short list of the weights they cover, so a
+   step costs the same however many tiles there are.
+
+   The weights can be saved to a table file and loaded back. The file
+   is mapped into memory. It is in host byte order and holds, in this
+   order:
+   - the magic "SARSAQT" and a NUL
+   - a uint32 version
+   - uint32 counts of dimensions, tilings, tiles, actions and the row
+     stride
+   - a uint64 weight count and a uint64 FNV-1a checksum of everything
+     after the header
+   - each dimension's range as two doubles
+   - at the next multiple of 64 bytes, the float32 weights
+   A table only loads into an engine of the same shape. */
+class SarsaLambda
+{
+public:
+  enum class Kernel { Scalar, Avx2 };
+
+private:
+  struct Trace {
+    uint32_t weight; /* index into the weights */
+    float value;
+  };
+
+  TileCoder coder_;
+  size_t actions_;
+  size_t stride_; /* actions, rounded up to a multiple of 8 */
+  std::unique_ptr<float, void (*)( void * )> weights_;
+
+  double alpha_; /* step size, shared between the tilings */
+  double epsilon_;
+  double gamma_;
+  double lambda_;
+
+  Kernel kernel_;
+  XorShift random_;
+  std::vector<Trace> traces_;
+
+  /* the state and action of the last step, and its Q value */
+  std::vector<uint32_t> active_;
+  size_t action_;
+  double q_;
+  bool has_action_;
+
+  /* scratch: the next state's tiles and Q values (stride_ floats) */
+  std::vector<uint32_t> next_active_;
+  std::vector<float> q_values_;
+
+  void evaluate( const std::vector<uint32_t> & active );
+  size_t best_action( void ) const;
+  void trace( const std::vector<uint32_t> & active, const size_t action );
+
+public:
+  SarsaLambda( const TileCoder & coder, const size_t actions,
+	       const double alpha, const double epsilon,
+	       const double gamma, const double lambda,
+	       const uint64_t seed );
+
+  /* The last action earned reward and led to a state with these
+     features: learn from that, then pick (epsilon-greedily) and return
+     the next action. The first step only picks. */
+  size_t step( const double reward, const std::vector<double> & features );
+
+  /* Forget the last state and action (the next step starts afresh) */
+  void reset( void );
+
+  /* A prior: make action the greedy one around a state, worth value */
+  void prefer_action( const std::vector<double> & features,
+		      const size_t action, const double value );
+
+  /* Write the weights to a table file. The file is written under a
+     temporary name, then renamed, so a reader never sees half a table. */
+  void save( const std::string & path ) const;
+
+  /* Copy the weights out, and write such a copy to a table file in
+     this engine's shape (safe to call while another thread steps) */
+  void snapshot( std::vector<float> & weights ) const;
+  void save( const std::string & path, const std::vector<float> & weights ) const;
+
+  /* Replace the weights with a saved table. Returns false if there is
+     no file at path; throws if the file is not a valid table of this
+     shape. */
+  bool load( const std::string & path );
+
+  /* The Q value of the last step's action */
+  double q( void ) const { return q_; }
+
+  size_t actions( void ) const { return actions_; }
+  void set_epsilon( const double epsilon ) { epsilon_ = epsilon; }
+
+  Kernel kernel( void ) const { return kernel_; }
+  void set_kernel( const Kernel kernel ) { kernel_ = kernel; }
+};
+
+/* Saves an engine's table on a thread of its own, so that saving never
+   holds up the caller: save() only copies the weights, and the thread
+   writes the copy (a newer copy replaces one not yet written). A copy
+   still waiting is written before the saver is destroyed. */
+class TableSaver
+{
+private:
+  const SarsaLambda & engine_;
+  std::string path_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<float> pending_; /* the copy to write next */
+  bool has_pending_;
+  bool stopping_;
+
+  std::thread thread_;
+
+  void run( void );
+
+public:
+  TableSaver( const SarsaLambda & engine, const std::string & path );
+  ~TableSaver();
+
+  void save( void );
+
+  TableSaver( const TableSaver & other ) = delete;
+  const TableSaver & operator=( const TableSaver & other ) = delete;
+};
+
+#endif
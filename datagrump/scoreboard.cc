@@ -0,0 +1,101 @@
+#include <stdexcept>
+
+#include "scoreboard.hh"
+
+using namespace std;
+
+/* starting ring size in words (grows as needed) */
+static const size_t INITIAL_WORDS = 16;
+
+Scoreboard::Scoreboard( const size_t datagram_size )
+  : acked_( INITIAL_WORDS ),
+    lost_( INITIAL_WORDS ),
+    base_( 0 ),
+    next_( 0 ),
+    in_flight_( 0 ),
+    delivered_( 0 ),
+    datagram_size_( datagram_size )
+{}
+
+/* double the rings, keeping words in sequence order */
+void Scoreboard::grow( void )
+{
+  vector<uint64_t> acked( 2 * acked_.size() ), lost( 2 * lost_.size() );
+
+  for ( uint64_t seq = base_; seq < next_; seq += 64 ) {
+    const size_t new_word = (seq / 64) & (acked.size() - 1);
+    acked[ new_word ] = acked_[ word( seq ) ];
+    lost[ new_word ] = lost_[ word( seq ) ];
+  }
+
+  acked_.swap( acked );
+  lost_.swap( lost );
+}
+
+/* stop tracking leading words whose datagrams are all acked or lost */
+void Scoreboard::trim( void )
+{
+  while ( base_ + 64 <= next_
+	  and (acked_[ word( base_ ) ] | lost_[ word( base_ ) ]) == uint64_t( -1 ) ) {
+    acked_[ word( base_ ) ] = lost_[ word( base_ ) ] = 0;
+    base_ += 64;
+  }
+}
+
+/* A datagram was sent (sequence numbers must be consecutive) */
+void Scoreboard::sent( const uint64_t sequence_number )
+{
+  if ( sequence_number != next_ ) {
+    throw runtime_error( "scoreboard: datagrams must be sent in sequence order" );
+  }
+
+  if ( (next_ - base_) / 64 >= acked_.size() ) {
+    grow();
+  }
+
+  next_++;
+  in_flight_++;
+}
+
+/* A datagram was acked; returns whether this is its first ack */
+bool Scoreboard::acked( const uint64_t sequence_number )
+{
+  /* ignore acks for datagrams never sent or no longer tracked */
+  if ( sequence_number < base_ or sequence_number >= next_
+       or (acked_[ word( sequence_number ) ] & bit( sequence_number )) ) {
+    return false;
+  }
+
+  if ( lost_[ word( sequence_number ) ] & bit( sequence_number ) ) {
+    /* it wasn't lost after all (and already left the flight) */
+    lost_[ word( sequence_number ) ] &= ~bit( sequence_number );
+  } else {
+    in_flight_--;
+  }
+
+  acked_[ word( sequence_number ) ] |= bit( sequence_number );
+  delivered_++;
+  trim();
+  return true;
+}
+
+/* Declare an outstanding datagram lost; returns whether it was outstanding */
+bool Scoreboard::mark_lost( const uint64_t sequence_number )
+{
+  if ( not is_outstanding( sequence_number ) ) {
+    return false;
+  }
+
+  lost_[ word( sequence_number ) ] |= bit( sequence_number );
+  in_flight_--;
+  trim();
+  return true;
+}
+
+/* Is the datagram sent, but neither acked nor lost? */
+bool Scoreboard::is_outstanding( const uint64_t sequence_number ) const
+{
+  return sequence_number >= base_ and sequence_number < next_
+    and not ((acked_[ word( sequence_number ) ] | lost_[ word( sequence_number ) ])
+	     & bit( sequence_number ));
+}
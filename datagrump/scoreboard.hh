@@ -0,0 +1,64 @@
+#ifndef SCOREBOARD_HH
+#define SCOREBOARD_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* The sender's record of which datagrams are outstanding, acked or
+   lost, as bitmaps keyed by sequence number. A lost datagram or a
+   reordered ack doesn't disturb the counts: in flight is exactly the
+   datagrams sent but neither acked nor declared lost. */
+class Scoreboard
+{
+private:
+  /* one bit per datagram, in rings of 64-bit words (size a power of two) */
+  std::vector<uint64_t> acked_;
+  std::vector<uint64_t> lost_;
+
+  uint64_t base_; /* first sequence number tracked (a multiple of 64) */
+  uint64_t next_; /* next sequence number to be sent */
+
+  uint64_t in_flight_;
+  uint64_t delivered_;
+
+  size_t datagram_size_;
+
+  size_t word( const uint64_t sequence_number ) const
+  {
+    return (sequence_number / 64) & (acked_.size() - 1);
+  }
+
+  static uint64_t bit( const uint64_t sequence_number )
+  {
+    return uint64_t( 1 ) << (sequence_number % 64);
+  }
+
+  /* double the rings, keeping words in sequence order */
+  void grow( void );
+
+  /* stop tracking leading words whose datagrams are all acked or lost */
+  void trim( void );
+
+public:
+  Scoreboard( const size_t datagram_size );
+
+  /* A datagram was sent (sequence numbers must be consecutive) */
+  void sent( const uint64_t sequence_number );
+
+  /* A datagram was acked; returns whether this is its first ack */
+  bool acked( const uint64_t sequence_number );
+
+  /* Declare an outstanding datagram lost; returns whether it was outstanding */
+  bool mark_lost( const uint64_t sequence_number );
+
+  /* Is the datagram sent, but neither acked nor lost? */
+  bool is_outstanding( const uint64_t sequence_number ) const;
+
+  /* accessors */
+  uint64_t in_flight( void ) const { return in_flight_; }
+  uint64_t bytes_in_flight( void ) const { return in_flight_ * datagram_size_; }
+  uint64_t delivered( void ) const { return delivered_; }
+};
+
+#endif
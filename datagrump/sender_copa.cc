@@ -0,0 +1,433 @@
+/* UDP sender for congestion-control contest */
+
+#include <cstdlib>
+#include <iostream>
+
+#include "socket.hh"
+#include "contest_message.hh"
+#include "controller.hh"
+#include "poller.hh"
+#include "pacer.hh"
+#include "scoreboard.hh"
+#include "loss_detector.hh"
+#include "rate_sampler.hh"
+#include "ecn_counter.hh"
+#include "timerfd.hh"
+#include "timestamp.hh"
+
+using namespace std;
+using namespace PollerShortNames;
+
+/* All datagrams are the same size (1472 bytes fill a 1500-byte MTU
+   after the IPv4 and UDP headers); any room saved by the compact
+   header goes to the dummy payload */
+static const size_t DATAGRAM_SIZE = 1472;
+
+/* simple sender class to handle the accounting */
+class DatagrumpSender
+{
+private:
+  UDPSocket socket_;
+  Controller controller_; /* your class */
+
+  uint64_t sequence_number_; /* next outgoing sequence number */
+
+  /* which datagrams are outstanding, acked or lost */
+  Scoreboard scoreboard_;
+
+  /* decides when outstanding datagrams are lost */
+  LossDetector loss_detector_;
+
+  /* measures the delivery rate as each datagram is acked */
+  RateSampler rate_sampler_;
+
+  /* tallies the ECN marks the receiver echoes */
+  EcnCounter ecn_counter_;
+
+  /* header format for outgoing datagrams (compact once the receiver offers it) */
+  ContestMessage::Format format_;
+
+public:
+  /* how datagrams leave once the window opens: back-to-back (None),
+     released by a timer at the controller's pacing rate (Timer),
+     handed to the kernel stamped with departure times for the fq
+     qdisc (Txtime), or back-to-back under a socket-wide fq pacing
+     rate (MaxRate) */
+  enum class PacingMode { None, Timer, Txtime, MaxRate };
+
+private:
+  PacingMode pacing_mode_;
+  Pacer pacer_;
+  TimerFD pacing_timer_;
+  uint32_t max_pacing_rate_; /* last rate given to the kernel, bytes per second */
+
+  void send_datagram( void );
+  void got_ack( const uint64_t timestamp, const ContestMessage & msg );
+  bool window_is_open( void );
+  bool can_send( void );
+  void schedule_pacing_timer( void );
+  void update_max_pacing_rate( void );
+  void declare_losses( const std::vector<LossDetector::LostDatagram> & lost );
+  void run_loss_timers( void );
+
+public:
+  DatagrumpSender( const char * const host, const char * const port,
+		   const bool debug, const PacingMode pacing_mode,
+		   const double pacing_burst, const uint8_t ecn );
+  int loop( void );
+};
+
+int main( int argc, char *argv[] )
+{
+   /* check the command-line arguments */
+  if ( argc < 1 ) { /* for sticklers */
+    abort();
+  }
+
+  /* datagrams that a paced sender may send back-to-back,
+     unless given as pace=BURST or txtime=BURST */
+  static const double DEFAULT_PACING_BURST = 2;
+
+  bool debug = false;
+  DatagrumpSender::PacingMode pacing_mode = DatagrumpSender::PacingMode::None;
+  double pacing_burst = DEFAULT_PACING_BURST;
+  uint8_t ecn = UDPSocket::NOT_ECT;
+  bool usage_error = argc < 3;
+  for ( int i = 3; i < argc; i++ ) {
+    const string option( argv[ i ] );
+    const string name = option.substr( 0, option.find( '=' ) );
+    if ( name != option ) {
+      pacing_burst = atof( option.c_str() + name.size() + 1 );
+      usage_error |= pacing_burst < 1 or name == "debug" or name == "maxrate"
+	or name == "ecn" or name == "l4s";
+    }
+
+    if ( name == "debug" ) {
+      debug = true;
+    } else if ( name == "pace" ) {
+      pacing_mode = DatagrumpSender::PacingMode::Timer;
+    } else if ( name == "txtime" ) {
+      pacing_mode = DatagrumpSender::PacingMode::Txtime;
+    } else if ( name == "maxrate" ) {
+      pacing_mode = DatagrumpSender::PacingMode::MaxRate;
+    } else if ( name == "ecn" ) {
+      ecn = UDPSocket::ECT_0;
+    } else if ( name == "l4s" ) {
+      ecn = UDPSocket::ECT_1;
+    } else {
+      usage_error = true;
+    }
+  }
+
+  if ( usage_error ) {
+    cerr << "Usage: " << argv[ 0 ] << " HOST PORT [debug] "
+	 << "[pace[=BURST] | txtime[=BURST] | maxrate] [ecn | l4s]" << endl;
+    return EXIT_FAILURE;
+  }
+
+  /* create sender object to handle the accounting */
+  /* all the interesting work is done by the Controller */
+  DatagrumpSender sender( argv[ 1 ], argv[ 2 ], debug,
+			  pacing_mode, pacing_burst, ecn );
+  return sender.loop();
+}
+
+DatagrumpSender::DatagrumpSender( const char * const host,
+				  const char * const port,
+				  const bool debug,
+				  const PacingMode pacing_mode,
+				  const double pacing_burst,
+				  const uint8_t ecn )
+  : socket_(),
+    controller_( debug ),
+    sequence_number_( 0 ),
+    scoreboard_( DATAGRAM_SIZE ),
+    loss_detector_(),
+    rate_sampler_(),
+    ecn_counter_( ecn != UDPSocket::NOT_ECT ),
+    format_( ContestMessage::Format::Legacy ),
+    pacing_mode_( pacing_mode ),
+    pacer_( pacing_burst ),
+    pacing_timer_(),
+    max_pacing_rate_( -1 )
+{
+  /* turn on timestamps when socket receives a datagram */
+  socket_.set_timestamps();
+
+  /* mark datagrams ECN-capable: ECT(0) for classic ECN, ECT(1) for
+     L4S-style marking */
+  if ( ecn != UDPSocket::NOT_ECT ) {
+    socket_.set_ecn( ecn );
+  }
+
+  /* let the kernel hold datagrams until their departure times */
+  if ( pacing_mode_ == PacingMode::Txtime ) {
+    socket_.set_txtime();
+  }
+
+  /* (falling back from txtime to the timer still paces) */
+  controller_.set_paced( pacing_mode_ != PacingMode::None );
+
+  /* connect socket to the remote host */
+  /* (note: this doesn't send anything; it just tags the socket
+     locally with the remote address */
+  socket_.connect( Address( host, port ) );  
+
+  cerr << "Sending to " << socket_.peer_address().to_string() << endl;
+}
+
+void DatagrumpSender::got_ack( const uint64_t timestamp,
+			       const ContestMessage & ack )
+{
+  if ( not ack.is_ack() ) {
+    throw runtime_error( "sender got something other than an ack from the receiver" );
+  }
+
+  /* Switch to the compact header if the receiver supports it */
+  if ( ack.header.format == ContestMessage::Format::Legacy
+       and ack.offers_compact() ) {
+    format_ = ContestMessage::Format::Compact;
+  }
+
+  /* An ack that arrives before its datagram's departure time means
+     no fq qdisc is honoring SO_TXTIME; pace with the timer instead */
+  if ( pacing_mode_ == PacingMode::Txtime
+       and timestamp < ack.header.ack_send_timestamp ) {
+    cerr << "Transmit times are being ignored (is the fq qdisc installed?); "
+	 << "pacing with a timer instead" << endl;
+    pacing_mode_ = PacingMode::Timer;
+  }
+
+  /* Never report an ack from before its datagram was sent */
+  const uint64_t send_timestamp = min( ack.header.ack_send_timestamp, timestamp );
+
+  /* Update sender's scoreboard */
+  scoreboard_.acked( ack.header.ack_sequence_number );
+  loss_detector_.acked( ack.header.ack_sequence_number,
+			send_timestamp, timestamp );
+
+  RateSample rate_sample = RateSample();
+  const bool have_rate_sample = rate_sampler_.acked( ack.header.ack_sequence_number,
+						     timestamp, rate_sample );
+
+  /* Inform congestion controller */
+  controller_.ack_received( ack.header.ack_sequence_number,
+			    send_timestamp,
+			    ack.header.ack_recv_timestamp,
+			    timestamp );
+
+  if ( have_rate_sample ) {
+    controller_.delivery_rate_sampled( rate_sample );
+  }
+
+  /* Only compact acks echo ECN bits */
+  if ( ack.header.format == ContestMessage::Format::Compact ) {
+    const bool was_capable = ecn_counter_.capable();
+    EcnSample ecn_sample = EcnSample();
+    if ( ecn_counter_.acked( ack.header.ack_sequence_number, ack.header.ack_ecn,
+			     sequence_number_, ecn_sample ) ) {
+      controller_.ecn_sampled( ecn_sample );
+    } else if ( was_capable and not ecn_counter_.capable() ) {
+      cerr << "ECN bits are not getting through; not marking datagrams" << endl;
+      socket_.set_ecn( UDPSocket::NOT_ECT );
+    }
+  }
+
+  /* Datagrams sent well before this one that are still unacked are lost */
+  declare_losses( loss_detector_.detect_losses( timestamp ) );
+
+  controller_.flight_updated( scoreboard_.in_flight(),
+			      scoreboard_.bytes_in_flight(),
+			      scoreboard_.delivered() );
+}
+
+void DatagrumpSender::send_datagram( void )
+{
+  ContestMessage cm( sequence_number_++, "" );
+  cm.header.format = format_;
+  cm.payload.assign( DATAGRAM_SIZE - cm.header.wire_length(), 'x' );
+  cm.set_send_timestamp();
+  const uint64_t handed_over = cm.header.send_timestamp;
+
+  if ( pacing_mode_ == PacingMode::Txtime ) {
+    /* stamp the datagram with its departure time, so the echoed
+       send time leaves out the time the kernel held it */
+    const uint64_t now = monotonic_ns();
+    pacer_.set_rate( controller_.pacing_rate(), now );
+    const uint64_t departure = pacer_.departure_time( now );
+    cm.header.send_timestamp += (departure - now) / 1000000;
+    socket_.send( cm.to_string(), departure );
+    pacer_.datagram_sent( now );
+  } else {
+    socket_.send( cm.to_string() );
+  }
+
+  rate_sampler_.sent( cm.header.sequence_number, handed_over,
+		      scoreboard_.in_flight() );
+  scoreboard_.sent( cm.header.sequence_number );
+  loss_detector_.sent( cm.header.sequence_number, handed_over );
+
+  if ( pacing_mode_ == PacingMode::Timer ) {
+    pacer_.datagram_sent( monotonic_ns() );
+  }
+
+  /* Inform congestion controller */
+  controller_.datagram_was_sent( cm.header.sequence_number, handed_over );
+}
+
+bool DatagrumpSender::window_is_open( void )
+{
+  return scoreboard_.in_flight() < controller_.window_size();
+}
+
+/* is the window open and (in paced mode) has the pacer released a datagram? */
+bool DatagrumpSender::can_send( void )
+{
+  if ( not window_is_open() ) {
+    return false;
+  } else if ( pacing_mode_ != PacingMode::Timer ) {
+    return true;
+  }
+
+  const uint64_t now = monotonic_ns();
+  pacer_.set_rate( controller_.pacing_rate(), now );
+  return pacer_.departure_time( now ) <= now;
+}
+
+/* wake up when the pacer will next release a datagram into an open window */
+void DatagrumpSender::schedule_pacing_timer( void )
+{
+  if ( window_is_open() ) {
+    const uint64_t now = monotonic_ns();
+    pacer_.set_rate( controller_.pacing_rate(), now );
+    pacing_timer_.arm( pacer_.departure_time( now ) );
+  } else {
+    pacing_timer_.disarm();
+  }
+}
+
+/* keep the kernel's pacing rate in step with the controller's */
+void DatagrumpSender::update_max_pacing_rate( void )
+{
+  const double rate = controller_.pacing_rate() * DATAGRAM_SIZE;
+
+  /* no rate yet means no limit */
+  const uint32_t bytes_per_second
+    = rate > 0 ? uint32_t( min( rate, double( uint32_t( -2 ) ) ) ) : uint32_t( -1 );
+
+  /* skip the system call unless the rate moved by more than 1/16 */
+  const uint32_t change = bytes_per_second > max_pacing_rate_
+    ? bytes_per_second - max_pacing_rate_ : max_pacing_rate_ - bytes_per_second;
+  if ( change > max_pacing_rate_ / 16 ) {
+    socket_.set_max_pacing_rate( bytes_per_second );
+    max_pacing_rate_ = bytes_per_second;
+  }
+}
+
+/* tell the scoreboard and the controller about lost datagrams */
+void DatagrumpSender::declare_losses( const vector<LossDetector::LostDatagram> & lost )
+{
+  for ( const auto & datagram : lost ) {
+    if ( scoreboard_.mark_lost( datagram.sequence_number ) ) {
+      rate_sampler_.lost( datagram.sequence_number );
+      controller_.packet_lost( datagram.sequence_number,
+			       datagram.send_timestamp );
+    }
+  }
+}
+
+/* declare losses, and send a tail-loss probe, when they come due */
+void DatagrumpSender::run_loss_timers( void )
+{
+  const uint64_t now = timestamp_ms();
+
+  const auto & lost = loss_detector_.detect_losses( now );
+  if ( not lost.empty() ) {
+    declare_losses( lost );
+    controller_.flight_updated( scoreboard_.in_flight(),
+				scoreboard_.bytes_in_flight(),
+				scoreboard_.delivered() );
+  }
+
+  /* the probe's ack will expose any losses at the tail of the flight */
+  if ( loss_detector_.tail_loss_probe_due( now ) ) {
+    send_datagram();
+  }
+}
+
+int DatagrumpSender::loop( void )
+{
+  /* read and write from the receiver using an event-driven "poller" */
+  Poller poller;
+
+  /* first rule: if the window is open, close it by
+     sending more datagrams */
+  poller.add_action( Action( socket_, Direction::Out, [&] () {
+	/* Close the window (as fast as the pacer allows) */
+	while ( can_send() ) {
+	  send_datagram();
+	}
+	return ResultType::Continue;
+      },
+      /* We're only interested in this rule when the window is open */
+      [&] () { return can_send(); } ) );
+
+  /* second rule: if sender receives an ack,
+     process it and inform the controller
+     (by using the sender's got_ack method) */
+  poller.add_action( Action( socket_, Direction::In, [&] () {
+	const UDPSocket::received_datagram recd = socket_.recv();
+	const ContestMessage ack  = recd.payload;
+	got_ack( recd.timestamp, ack );
+	return ResultType::Continue;
+      } ) );
+
+  /* third rule (timer-paced mode): when the pacing timer fires,
+     send the datagrams the pacer has released */
+  if ( pacing_mode_ == PacingMode::Timer
+       or pacing_mode_ == PacingMode::Txtime ) {
+    poller.add_action( Action( pacing_timer_, Direction::In, [&] () {
+	  pacing_timer_.read_expirations();
+	  while ( can_send() ) {
+	    send_datagram();
+	  }
+	  return ResultType::Continue;
+	} ) );
+  }
+
+  /* Run these rules forever */
+  while ( true ) {
+    if ( pacing_mode_ == PacingMode::Timer ) {
+      schedule_pacing_timer();
+    } else if ( pacing_mode_ == PacingMode::MaxRate ) {
+      update_max_pacing_rate();
+    }
+
+    /* Wait for an event, the loss detector's next timer,
+       or the controller's timeout, whichever comes first */
+    const uint64_t now = timestamp_ms();
+    const uint64_t loss_timer = loss_detector_.next_timer();
+    const unsigned int timeout = controller_.timeout_ms();
+    const bool loss_timer_first = loss_timer < now + timeout;
+
+    const auto ret = poller.poll( not loss_timer_first ? timeout
+				  : loss_timer > now ? loss_timer - now : 0 );
+    if ( ret.result == PollResult::Exit ) {
+      return ret.exit_status;
+    }
+
+    run_loss_timers();
+
+    if ( ret.result == PollResult::Timeout and not loss_timer_first ) {
+      /* Nothing came back for a whole timeout: presume what's in flight is lost */
+      controller_.timeout_expired();
+      declare_losses( loss_detector_.declare_all_lost() );
+      controller_.flight_updated( scoreboard_.in_flight(),
+				  scoreboard_.bytes_in_flight(),
+				  scoreboard_.delivered() );
+
+      /* After a timeout, send one datagram to try to get things moving again */
+      send_datagram();
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <limits>
+
+#include "slow_start.hh"
+
+#define LOW_WINDOW 16 /* the exit tests wait for a window this big */
+#define MIN_SAMPLES 8 /* RTT samples per round the delay test needs */
+#define MIN_THRESHOLD 4 /* ms */
+#define MAX_THRESHOLD 16
+#define ACK_SPACING 2 /* ms; closer acks are one train */
+#define RATE_GROWTH 1.25 /* per round, for the rate to count as growing */
+#define FLAT_ROUNDS 3
+
+using namespace std;
+
+static const double NO_RTT = numeric_limits<double>::infinity();
+
+SlowStart::SlowStart()
+  : exit_( Exit::None ),
+    paced_( false ),
+    round_start_timestamp_( 0 ),
+    last_ack_timestamp_( 0 ),
+    last_round_min_rtt_( NO_RTT ),
+    current_round_min_rtt_( NO_RTT ),
+    round_rtt_samples_( 0 ),
+    full_rate_( 0 ),
+    round_max_rate_( 0 ),
+    flat_rounds_( 0 )
+{}
+
+const char * SlowStart::exit_name( void ) const
+{
+  switch ( exit_ ) {
+  case Exit::None: return "still in slow start";
+  case Exit::AckTrain: return "ack train";
+  case Exit::DelayIncrease: return "delay increase";
+  case Exit::RatePlateau: return "delivery-rate plateau";
+  case Exit::Loss: return "loss";
+  case Exit::Skipped: return "skipped";
+  }
+  return "?";
+}
+
+double SlowStart::acked( const double window, const uint64_t send_timestamp,
+			 const double rtt, const double min_rtt, const uint64_t now )
+{
+  if ( not active() ) {
+    return 0;
+  }
+
+  if ( send_timestamp >= round_start_timestamp_ ) {
+    /* a new round: did the last one raise the delivery rate? */
+    if ( round_max_rate_ > 0 ) {
+      if ( round_max_rate_ >= full_rate_ * RATE_GROWTH ) {
+	full_rate_ = round_max_rate_;
+	flat_rounds_ = 0;
+      } else {
+	flat_rounds_++;
+      }
+    }
+
+    last_round_min_rtt_ = current_round_min_rtt_;
+    current_round_min_rtt_ = NO_RTT;
+    round_rtt_samples_ = 0;
+    round_max_rate_ = 0;
+    round_start_timestamp_ = last_ack_timestamp_ = now;
+  }
+  current_round_min_rtt_ = min( current_round_min_rtt_, rtt );
+  round_rtt_samples_++;
+
+  /* the ack train runs from the round's first ack for as long as acks
+     keep coming back to back; the last ack only advances while it
+     does, so once a gap breaks the train it stays broken for the rest
+     of the round (as in Linux) */
+  const bool train_ongoing = now - last_ack_timestamp_ <= ACK_SPACING;
+  if ( train_ongoing ) {
+    last_ack_timestamp_ = now;
+  }
+
+  if ( window < LOW_WINDOW ) {
+    return 1;
+  }
+
+  const double train_length = paced_ ? min_rtt : min_rtt / 2.0;
+  if ( train_ongoing and now - round_start_timestamp_ >= train_length ) {
+    exit_ = Exit::AckTrain;
+  } else if ( round_rtt_samples_ >= MIN_SAMPLES and last_round_min_rtt_ != NO_RTT
+	      and current_round_min_rtt_ >= last_round_min_rtt_
+	      + max( double( MIN_THRESHOLD ), min( double( MAX_THRESHOLD ), last_round_min_rtt_ / 8 ) ) ) {
+    exit_ = Exit::DelayIncrease;
+  } else if ( flat_rounds_ >= FLAT_ROUNDS ) {
+    exit_ = Exit::RatePlateau;
+  }
+
+  return active() ? 1 : 0;
+}
+
+void SlowStart::delivery_rate_sampled( const RateSample & sample )
+{
+  round_max_rate_ = max( round_max_rate_, sample.delivery_rate );
+}
+
+void SlowStart::lost( void )
+{
+  if ( active() ) {
+    exit_ = Exit::Loss;
+  }
+}
+
+void SlowStart::skip( void )
+{
+  if ( active() ) {
+    exit_ = Exit::Skipped;
+  }
+}
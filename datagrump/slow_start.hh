@@ -0,0 +1,67 @@
+#ifndef SLOW_START_HH
+#define SLOW_START_HH
+
+#include <cstdint>
+
+#include "rate_sampler.hh"
+
+/* A startup phase any window-based controller can opt into: while it
+   is active, the controller grows its window by what acked() returns
+   (a datagram per ack, doubling the window every round trip) instead
+   of by its own rule, and hands over to its steady state once it
+   ends. It ends on whichever comes first:
+
+   - HyStart's ack train: acks arriving back to back for half the min
+     RTT (a whole min RTT when paced) mean the window fills the path;
+   - HyStart's delay increase (RFC 9406): a round's min RTT an eighth
+     (4-16 ms) above the last round's means a queue is forming;
+   - a delivery-rate plateau, as in BBR's startup: three rounds in a
+     row without the delivery rate growing by a quarter;
+   - a loss, or any other congestion signal of the controller's own,
+     reported through lost().
+
+   A round ends with the ack of the first datagram sent after it
+   began. */
+class SlowStart
+{
+public:
+  enum class Exit { None, AckTrain, DelayIncrease, RatePlateau, Loss, Skipped };
+
+private:
+  Exit exit_;
+  bool paced_;
+
+  uint64_t round_start_timestamp_;
+  uint64_t last_ack_timestamp_; /* of the round's ack train so far */
+  double last_round_min_rtt_, current_round_min_rtt_;
+  unsigned int round_rtt_samples_;
+
+  double full_rate_;        /* the delivery rate, last time it grew enough */
+  double round_max_rate_;
+  unsigned int flat_rounds_; /* rounds since then */
+
+public:
+  SlowStart();
+
+  bool active( void ) const { return exit_ == Exit::None; }
+  Exit exit_reason( void ) const { return exit_; }
+  const char * exit_name( void ) const;
+
+  /* An ack while the window was this big: returns how much to grow the
+     window by (0 once slow start has ended) */
+  double acked( const double window, const uint64_t send_timestamp,
+		const double rtt, const double min_rtt, const uint64_t now );
+
+  void delivery_rate_sampled( const RateSample & sample );
+
+  /* A loss or other congestion signal: slow start is over */
+  void lost( void );
+
+  /* The controller took over a window already in use: no slow start */
+  void skip( void );
+
+  /* Whether the sender paces (its acks come spread out even with no queue) */
+  void set_paced( const bool paced ) { paced_ = paced; }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "whisker_tree.hh"
+
+#define ALPHA (1.0 / 8)
+#define SLOW_ALPHA (1.0 / 256)
+
+using namespace std;
+
+WhiskerMemory::WhiskerMemory()
+  : ack_ewma_( ALPHA ),
+    send_ewma_( ALPHA ),
+    slow_ack_ewma_( SLOW_ALPHA ),
+    last_send_( 0 ),
+    last_ack_( 0 ),
+    min_rtt_( 0 ),
+    rtt_ratio_( 0 ),
+    has_ack_( false )
+{}
+
+void WhiskerMemory::acked( const uint64_t send_timestamp, const uint64_t ack_timestamp )
+{
+  const uint64_t rtt = ack_timestamp - send_timestamp;
+
+  if ( not has_ack_ ) {
+    min_rtt_ = rtt;
+    has_ack_ = true;
+  } else {
+    /* (a reordered ack counts as no time between sends) */
+    send_ewma_.update( send_timestamp - min( send_timestamp, last_send_ ) );
+    ack_ewma_.update( ack_timestamp - last_ack_ );
+    slow_ack_ewma_.update( ack_timestamp - last_ack_ );
+    min_rtt_ = min( min_rtt_, rtt );
+    rtt_ratio_ = double( rtt ) / max( uint64_t( 1 ), min_rtt_ );
+  }
+
+  last_send_ = max( last_send_, send_timestamp );
+  last_ack_ = ack_timestamp;
+}
+
+void WhiskerMemory::reset( void )
+{
+  *this = WhiskerMemory();
+}
+
+WhiskerMemory::State WhiskerMemory::state( void ) const
+{
+  return State { { ack_ewma_.get(), send_ewma_.get(), rtt_ratio_, slow_ack_ewma_.get() } };
+}
+
+double WhiskerAction::window( const double current ) const
+{
+  return max( 0.0, current * window_multiple + window_increment );
+}
+
+WhiskerTree::WhiskerTree( const string & rules )
+  : nodes_( 1 ),
+    actions_( 1, WhiskerAction { 1, 0, 0 } )
+{
+  vector<Whisker> whiskers;
+
+  istringstream lines( rules );
+  string line;
+  for ( unsigned int line_number = 1; getline( lines, line ); line_number++ ) {
+    line = line.substr( 0, line.find( '#' ) );
+    istringstream fields( line );
+
+    Whisker whisker = Whisker();
+    WhiskerAction action = WhiskerAction();
+    if ( not ( fields >> whisker.lower[ 0 ] ) ) {
+      continue; /* blank or comment */
+    }
+    fields >> whisker.upper[ 0 ];
+    for ( size_t signal = 1; signal < WhiskerMemory::NUM_SIGNALS; signal++ ) {
+      fields >> whisker.lower[ signal ] >> whisker.upper[ signal ];
+    }
+    fields >> action.window_multiple >> action.window_increment >> action.intersend;
+
+    string extra;
+    if ( not fields or fields >> extra ) {
+      throw runtime_error( "whisker table line " + to_string( line_number )
+			   + ": expected 8 bounds and 3 action values" );
+    }
+    for ( size_t signal = 0; signal < WhiskerMemory::NUM_SIGNALS; signal++ ) {
+      if ( not ( whisker.lower[ signal ] < whisker.upper[ signal ] ) ) {
+	throw runtime_error( "whisker table line " + to_string( line_number )
+			     + ": empty box" );
+      }
+    }
+
+    whisker.action = actions_.size();
+    actions_.push_back( action );
+    whiskers.push_back( whisker );
+  }
+
+  WhiskerMemory::State lower, upper;
+  lower.fill( -numeric_limits<double>::infinity() );
+  upper.fill( numeric_limits<double>::infinity() );
+  build( 0, lower, upper, whiskers );
+}
+
+/* Compile the whiskers that meet the region [lower, upper) into the
+   subtree at nodes_[ index ]. Each split is at a whisker's boundary,
+   chosen to cut as few whiskers in two as possible (a cut whisker
+   lands on both sides), then to balance the sides. */
+void WhiskerTree::build( const size_t index,
+			 const WhiskerMemory::State & lower, const WhiskerMemory::State & upper,
+			 const vector<Whisker> & whiskers )
+{
+  if ( whiskers.empty() ) {
+    nodes_[ index ] = Node { 0, LEAF, 0 };
+    return;
+  }
+
+  size_t best_signal = LEAF;
+  double best_split = 0;
+  size_t best_cost = 0;
+
+  for ( size_t signal = 0; signal < WhiskerMemory::NUM_SIGNALS; signal++ ) {
+    for ( const Whisker & candidate : whiskers ) {
+      for ( const double split : { candidate.lower[ signal ], candidate.upper[ signal ] } ) {
+	if ( not ( split > lower[ signal ] and split < upper[ signal ] ) ) {
+	  continue;
+	}
+
+	size_t left = 0, right = 0;
+	for ( const Whisker & whisker : whiskers ) {
+	  left += whisker.lower[ signal ] < split;
+	  right += whisker.upper[ signal ] > split;
+	}
+
+	const size_t cost = (left + right) * whiskers.size() + max( left, right );
+	if ( best_signal == LEAF or cost < best_cost ) {
+	  best_signal = signal;
+	  best_split = split;
+	  best_cost = cost;
+	}
+      }
+    }
+  }
+
+  /* no boundary crosses the region: the first whisker covers it all
+     (whiskers should not overlap; if they do, the earlier one wins) */
+  if ( best_signal == LEAF ) {
+    nodes_[ index ] = Node { 0, LEAF, whiskers.front().action };
+    return;
+  }
+
+  vector<Whisker> left_whiskers, right_whiskers;
+  for ( const Whisker & whisker : whiskers ) {
+    if ( whisker.lower[ best_signal ] < best_split ) {
+      left_whiskers.push_back( whisker );
+    }
+    if ( whisker.upper[ best_signal ] > best_split ) {
+      right_whiskers.push_back( whisker );
+    }
+  }
+
+  const uint32_t next = nodes_.size();
+  nodes_.resize( next + 2 );
+  nodes_[ index ] = Node { best_split, uint32_t( best_signal ), next };
+
+  WhiskerMemory::State left_upper = upper, right_lower = lower;
+  left_upper[ best_signal ] = right_lower[ best_signal ] = best_split;
+  build( next, lower, left_upper, left_whiskers );
+  build( next + 1, right_lower, upper, right_whiskers );
+}
@@ -0,0 +1,106 @@
+#ifndef WHISKER_TREE_HH
+#define WHISKER_TREE_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "estimators.hh"
+
+/* Remy's congestion signals, updated on every ack: EWMAs of the time
+   between acks and between the acked datagrams' sends (ms, gain 1/8),
+   the RTT over the minimum RTT, and a slow EWMA of the time between
+   acks (gain 1/256). */
+class WhiskerMemory
+{
+public:
+  enum Signal { AckEwma, SendEwma, RttRatio, SlowAckEwma, NUM_SIGNALS };
+  typedef std::array<double, NUM_SIGNALS> State;
+
+private:
+  Ewma ack_ewma_;
+  Ewma send_ewma_;
+  Ewma slow_ack_ewma_;
+  uint64_t last_send_;
+  uint64_t last_ack_;
+  uint64_t min_rtt_;
+  double rtt_ratio_;
+  bool has_ack_;
+
+public:
+  WhiskerMemory();
+
+  void acked( const uint64_t send_timestamp, const uint64_t ack_timestamp );
+
+  /* Forget everything (as at the start of a flow) */
+  void reset( void );
+
+  /* The signals, all 0 until the second ack */
+  State state( void ) const;
+};
+
+/* What a whisker does on an ack: the window becomes
+   window * window_multiple + window_increment, and datagrams leave at
+   least intersend milliseconds apart (0 for no pacing) */
+struct WhiskerAction {
+  double window_multiple;
+  double window_increment;
+  double intersend;
+
+  double window( const double current ) const;
+};
+
+/* A Remy rule table: whiskers, each an action for a box of memory
+   states. The text form has one whisker per line (# starts a comment):
+
+     ack_lo ack_hi send_lo send_hi ratio_lo ratio_hi slow_lo slow_hi multiple increment intersend
+
+   Lower bounds are inclusive, upper bounds exclusive. The whiskers are
+   compiled into a flat k-d tree: each node splits on one signal and
+   its two children sit side by side, so a lookup is a short loop of
+   loads and compares with no data-dependent branch but the loop's
+   own. States outside every whisker get the default action (hold the
+   window, no pacing). */
+class WhiskerTree
+{
+private:
+  static const uint32_t LEAF = WhiskerMemory::NUM_SIGNALS;
+
+  struct Node {
+    double split;
+    uint32_t signal; /* LEAF for a leaf */
+    uint32_t next;   /* the left child (right is next + 1), or a leaf's action */
+  };
+
+  struct Whisker {
+    WhiskerMemory::State lower, upper;
+    uint32_t action;
+  };
+
+  std::vector<Node> nodes_; /* the root is nodes_[ 0 ] */
+  std::vector<WhiskerAction> actions_; /* actions_[ 0 ] is the default */
+
+  void build( const size_t index,
+	      const WhiskerMemory::State & lower, const WhiskerMemory::State & upper,
+	      const std::vector<Whisker> & whiskers );
+
+public:
+  /* Parse and compile a rule table in the text form above */
+  WhiskerTree( const std::string & rules );
+
+  const WhiskerAction & lookup( const WhiskerMemory::State & state ) const
+  {
+    const Node * node = &nodes_[ 0 ];
+    while ( node->signal != LEAF ) {
+      node = &nodes_[ node->next + ( state[ node->signal ] >= node->split ) ];
+    }
+    return actions_[ node->next ];
+  }
+
+  size_t size( void ) const { return actions_.size() - 1; }
+  size_t nodes( void ) const { return nodes_.size(); }
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/net_tstamp.h>
 
 #include "socket.hh"
 #include "util.hh"
@@ -116,14 +118,25 @@ UDPSocket::received_datagram UDPSocket::recv( void )
   }
 
   uint64_t timestamp = -1;
+  uint8_t ecn = NOT_ECT;
 
-  /* find the timestamp header (if there is one) */
+  /* find the timestamp and traffic-class headers (if there are any);
+     an IPv4 datagram on this IPv6 socket carries IP_TOS (one byte),
+     an IPv6 one IPV6_TCLASS (an int) */
   cmsghdr *ts_hdr = CMSG_FIRSTHDR( &header );
   while ( ts_hdr ) {
     if ( ts_hdr->cmsg_level == SOL_SOCKET
 	 and ts_hdr->cmsg_type == SO_TIMESTAMPNS ) {
       const timespec * const kernel_time = reinterpret_cast<timespec *>( CMSG_DATA( ts_hdr ) );
       timestamp = timestamp_ms( *kernel_time );
+    } else if ( ts_hdr->cmsg_level == IPPROTO_IP
+		and ts_hdr->cmsg_type == IP_TOS ) {
+      ecn = *CMSG_DATA( ts_hdr ) & CE;
+    } else if ( ts_hdr->cmsg_level == IPPROTO_IPV6
+		and ts_hdr->cmsg_type == IPV6_TCLASS ) {
+      int traffic_class;
+      memcpy( &traffic_class, CMSG_DATA( ts_hdr ), sizeof( traffic_class ) );
+      ecn = traffic_class & CE;
     }
     ts_hdr = CMSG_NXTHDR( &header, ts_hdr );
   }
@@ -131,7 +144,8 @@ UDPSocket::received_datagram UDPSocket::recv( void )
   received_datagram ret = { Address( datagram_source_address,
 				     header.msg_namelen ),
 			    timestamp,
-			    string( msg_payload, recv_len ) };
+			    string( msg_payload, recv_len ),
+			    ecn };
 
   return ret;
 }
@@ -170,6 +184,44 @@ void UDPSocket::send( const string & payload )
   }
 }
 
+/* send datagram to connected address, to leave at a given time */
+void UDPSocket::send( const string & payload, const uint64_t txtime_ns )
+{
+  msghdr header; zero( header );
+  iovec msg_iovec; zero( msg_iovec );
+
+  union {
+    char buf[ CMSG_SPACE( sizeof( txtime_ns ) ) ];
+    cmsghdr align;
+  } msg_control;
+  zero( msg_control );
+
+  /* the payload */
+  msg_iovec.iov_base = const_cast<char *>( payload.data() );
+  msg_iovec.iov_len = payload.size();
+  header.msg_iov = &msg_iovec;
+  header.msg_iovlen = 1;
+
+  /* the transmit time */
+  header.msg_control = msg_control.buf;
+  header.msg_controllen = sizeof( msg_control.buf );
+
+  cmsghdr * const txtime_hdr = CMSG_FIRSTHDR( &header );
+  txtime_hdr->cmsg_level = SOL_SOCKET;
+  txtime_hdr->cmsg_type = SCM_TXTIME;
+  txtime_hdr->cmsg_len = CMSG_LEN( sizeof( txtime_ns ) );
+  memcpy( CMSG_DATA( txtime_hdr ), &txtime_ns, sizeof( txtime_ns ) );
+
+  const ssize_t bytes_sent =
+    SystemCall( "sendmsg", sendmsg( fd_num(), &header, 0 ) );
+
+  register_write();
+
+  if ( size_t( bytes_sent ) != payload.size() ) {
+    throw runtime_error( "datagram payload too big for sendmsg()" );
+  }
+}
+
 /* mark the socket as listening for incoming connections */
 void TCPSocket::listen( const int backlog )
 {
@@ -197,8 +249,53 @@ void Socket::set_reuseaddr( void )
   setsockopt( SOL_SOCKET, SO_REUSEADDR, int( true ) );
 }
 
+/* allow several sockets to bind the same local address and port */
+void Socket::set_reuseport( void )
+{
+  setsockopt( SOL_SOCKET, SO_REUSEPORT, int( true ) );
+}
+
+/* get and clear the pending error (e.g. ICMP unreachable on a connected socket) */
+int Socket::pending_error( void )
+{
+  int error;
+  socklen_t len = sizeof( error );
+  SystemCall( "getsockopt",
+	      getsockopt( fd_num(), SOL_SOCKET, SO_ERROR, &error, &len ) );
+  return error;
+}
+
 /* turn on timestamps on receipt */
 void UDPSocket::set_timestamps( void )
 {
   setsockopt( SOL_SOCKET, SO_TIMESTAMPNS, int( true ) );
 }
+
+/* mark outgoing datagrams with an ECN codepoint (the rest of the
+   traffic class stays 0); IP_TOS covers IPv4-mapped peers */
+void UDPSocket::set_ecn( const uint8_t codepoint )
+{
+  setsockopt( IPPROTO_IP, IP_TOS, int( codepoint & CE ) );
+  setsockopt( IPPROTO_IPV6, IPV6_TCLASS, int( codepoint & CE ) );
+}
+
+/* report the ECN bits of incoming datagrams */
+void UDPSocket::set_receive_ecn( void )
+{
+  setsockopt( IPPROTO_IP, IP_RECVTOS, int( true ) );
+  setsockopt( IPPROTO_IPV6, IPV6_RECVTCLASS, int( true ) );
+}
+
+/* let the kernel (fq qdisc) hold each datagram until its transmit time */
+void UDPSocket::set_txtime( void )
+{
+  sock_txtime config; zero( config );
+  config.clockid = CLOCK_MONOTONIC;
+  setsockopt( SOL_SOCKET, SO_TXTIME, config );
+}
+
+/* cap the rate at which the kernel (fq qdisc) paces this socket */
+void UDPSocket::set_max_pacing_rate( const uint32_t bytes_per_second )
+{
+  setsockopt( SOL_SOCKET, SO_MAX_PACING_RATE, bytes_per_second );
+}
@@ -38,6 +38,12 @@ public:
 
   /* allow local address to be reused sooner, at the cost of some robustness */
   void set_reuseaddr( void );
+
+  /* allow several sockets to bind the same local address and port */
+  void set_reuseport( void );
+
+  /* get and clear the pending error (e.g. ICMP unreachable on a connected socket) */
+  int pending_error( void );
 };
 
 /* UDP socket */
@@ -46,13 +52,17 @@ class UDPSocket : public Socket
 public:
   UDPSocket() : Socket( AF_INET6, SOCK_DGRAM ) {}
 
+  /* the two ECN bits of the IP header (RFC 3168) */
+  enum ECN : uint8_t { NOT_ECT = 0, ECT_1 = 1, ECT_0 = 2, CE = 3 };
+
   struct received_datagram {
     Address source_address;
     uint64_t timestamp;
     std::string payload;
+    uint8_t ecn; /* NOT_ECT unless set_receive_ecn() */
   };
 
-  /* receive datagram, timestamp, and where it came from */
+  /* receive datagram, timestamp, ECN bits, and where it came from */
   received_datagram recv( void );
 
   /* send datagram to specified address */
@@ -61,8 +71,24 @@ public:
   /* send datagram to connected address */
   void send( const std::string & payload );
 
+  /* send datagram to connected address, to leave at a given time
+     (nanoseconds on the monotonic clock; needs set_txtime()) */
+  void send( const std::string & payload, const uint64_t txtime_ns );
+
   /* turn on timestamps on receipt */
   void set_timestamps( void );
+
+  /* mark outgoing datagrams with an ECN codepoint (IPv4 and IPv6) */
+  void set_ecn( const uint8_t codepoint );
+
+  /* report the ECN bits of incoming datagrams */
+  void set_receive_ecn( void );
+
+  /* let the kernel (fq qdisc) hold each datagram until its transmit time */
+  void set_txtime( void );
+
+  /* cap the rate at which the kernel (fq qdisc) paces this socket */
+  void set_max_pacing_rate( const uint32_t bytes_per_second );
 };
 
 /* TCP socket */
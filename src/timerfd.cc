@@ -0,0 +1,54 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "timerfd.hh"
+#include "util.hh"
+
+using namespace std;
+
+/* nanoseconds per second */
+static const uint64_t BILLION = 1000000000;
+
+TimerFD::TimerFD()
+  : FileDescriptor( SystemCall( "timerfd_create",
+				timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK ) ) )
+{}
+
+/* fire at an absolute time (nanoseconds on the monotonic clock) */
+void TimerFD::arm( const uint64_t deadline_ns )
+{
+  itimerspec spec; zero( spec );
+
+  /* a zero it_value would disarm the timer instead */
+  spec.it_value.tv_sec = deadline_ns / BILLION;
+  spec.it_value.tv_nsec = deadline_ns % BILLION;
+  if ( spec.it_value.tv_sec == 0 and spec.it_value.tv_nsec == 0 ) {
+    spec.it_value.tv_nsec = 1;
+  }
+
+  SystemCall( "timerfd_settime",
+	      timerfd_settime( fd_num(), TFD_TIMER_ABSTIME, &spec, nullptr ) );
+}
+
+/* stop the timer from firing */
+void TimerFD::disarm( void )
+{
+  itimerspec spec; zero( spec );
+
+  SystemCall( "timerfd_settime",
+	      timerfd_settime( fd_num(), 0, &spec, nullptr ) );
+}
+
+/* consume the expiration (call when the timer is readable) */
+void TimerFD::read_expirations( void )
+{
+  uint64_t expirations;
+
+  /* the timer may have been re-armed since poll() saw it fire */
+  const ssize_t len = ::read( fd_num(), &expirations, sizeof( expirations ) );
+  if ( len < 0 and errno != EAGAIN ) {
+    throw unix_error( "read" );
+  }
+
+  register_read();
+}
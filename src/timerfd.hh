@@ -0,0 +1,24 @@
+#ifndef TIMERFD_HH
+#define TIMERFD_HH
+
+#include <cstdint>
+
+#include "file_descriptor.hh"
+
+/* timer that becomes readable at a deadline on the monotonic clock */
+class TimerFD : public FileDescriptor
+{
+public:
+  TimerFD();
+
+  /* fire at an absolute time (nanoseconds on the monotonic clock) */
+  void arm( const uint64_t deadline_ns );
+
+  /* stop the timer from firing */
+  void disarm( void );
+
+  /* consume the expiration (call when the timer is readable) */
+  void read_expirations( void );
+};
+
+#endif /* TIMERFD_HH */
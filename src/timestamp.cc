@@ -34,3 +34,11 @@ uint64_t timestamp_ms( const timespec & ts )
   const static uint64_t EPOCH = timestamp_ms_raw( current_time() );
   return timestamp_ms_raw( ts ) - EPOCH;
 }
+
+/* Current time in nanoseconds on the monotonic clock (for timers and pacing) */
+uint64_t monotonic_ns( void )
+{
+  timespec ret;
+  SystemCall( "clock_gettime", clock_gettime( CLOCK_MONOTONIC, &ret ) );
+  return ret.tv_sec * BILLION + ret.tv_nsec;
+}
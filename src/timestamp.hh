@@ -8,4 +8,7 @@
 uint64_t timestamp_ms( void );
 uint64_t timestamp_ms( const timespec & ts );
 
+/* Current time in nanoseconds on the monotonic clock (for timers and pacing) */
+uint64_t monotonic_ns( void );
+
 #endif /* TIMESTAMP_HH */